@@ -0,0 +1,215 @@
+// Connect 4
+// Contains function implementations for the computer player
+
+#include "ai.h"
+
+// Wins score WIN_SCORE plus the empty cells left, so faster wins are preferred
+static const int WIN_SCORE = 1000;
+static const int TIME_CHECK_NODES = 1024; // Nodes between clock reads
+
+// Without weights, or when they don't load, the policy falls back to its center-control estimate
+AIPlayer::AIPlayer(int moveTimeMs, const std::string& weightsPath)
+    : result(pack(0, -1, 0, false)), searchId(0), moveTime(moveTimeMs), hasJob(false), quit(false),
+      policy(1, weightsPath), runningId(0), nodeCount(0), stopped(false)
+{
+    policy.setStop([this]() { return shouldStop(); });
+    worker = std::thread(&AIPlayer::workerLoop, this);
+}
+
+AIPlayer::~AIPlayer()
+{
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        quit = true;
+        ++searchId; // Stop a search in progress
+    }
+    jobReady.notify_one();
+    worker.join();
+}
+
+
+
+// Search control
+//----------------------------------------------------------------------------------------//
+
+// Search a copy of the game in the background
+void AIPlayer::startSearch(const Connect4Game& game)
+{
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        job = game;
+        hasJob = true;
+        uint32_t id = searchId.fetch_add(1) + 1;
+        result.store(pack(id, -1, 0, false));
+    }
+    jobReady.notify_one();
+}
+
+// The running search sees the new id and stops, its results no longer match
+void AIPlayer::cancel()
+{
+    std::lock_guard<std::mutex> guard(jobLock);
+    hasJob = false;
+    searchId.fetch_add(1);
+}
+
+// Hand out a finished result exactly once
+bool AIPlayer::takeMove(int& col)
+{
+    uint64_t current = result.load();
+    if(!(current & (1u << 16)) || static_cast<uint32_t>(current >> 32) != searchId.load())
+        return false;
+
+    if(!result.compare_exchange_strong(current, current & ~uint64_t(1u << 16)))
+        return false;
+
+    col = static_cast<int>(current & 0xFF) - 1;
+    return true;
+}
+
+
+
+// Setters
+//----------------------------------------------------------------------------------------//
+
+void AIPlayer::setMoveTime(int moveTimeMs)
+{
+    moveTime = moveTimeMs;
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+// A search was started and hasn't finished or been cancelled
+bool AIPlayer::isThinking() const
+{
+    uint64_t current = result.load();
+    uint32_t id = searchId.load();
+    return id != 0 && static_cast<uint32_t>(current >> 32) == id && !(current & (1u << 17));
+}
+
+int AIPlayer::getBestMove() const
+{
+    uint64_t current = result.load();
+    if(static_cast<uint32_t>(current >> 32) != searchId.load())
+        return -1;
+
+    return static_cast<int>(current & 0xFF) - 1;
+}
+
+int AIPlayer::getDepth() const
+{
+    uint64_t current = result.load();
+    if(static_cast<uint32_t>(current >> 32) != searchId.load())
+        return 0;
+
+    return static_cast<int>((current >> 8) & 0xFF);
+}
+
+int AIPlayer::getMoveTime() const
+{
+    return moveTime;
+}
+
+
+
+// Private Helper Methods
+//----------------------------------------------------------------------------------------//
+
+// Wait for a job, search it, repeat until the player is destroyed
+void AIPlayer::workerLoop()
+{
+    while(true)
+    {
+        Connect4Game game;
+        {
+            std::unique_lock<std::mutex> guard(jobLock);
+            jobReady.wait(guard, [this]() { return hasJob || quit; });
+            if(quit)
+                return;
+
+            game = job;
+            hasJob = false;
+            runningId = searchId.load();
+        }
+
+        search(game);
+    }
+}
+
+// Iterative deepening: each finished depth replaces the published move
+void AIPlayer::search(const Connect4Game& game)
+{
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(moveTime.load());
+    nodeCount = 0;
+    stopped = false;
+
+    if(game.isGameOver())
+    {
+        publish(-1, 0, true);
+        return;
+    }
+
+    // Any legal move, in case not even depth 1 finishes
+    int bestMove = -1;
+    for(int col = 0; col < game.getCols() && bestMove < 0; ++col)
+    {
+        if(!game.isColumnFull(col))
+            bestMove = col;
+    }
+
+    int depth = 0;
+    int empty = game.getRows() * game.getCols() - game.getMoveCount();
+    while(depth < empty)
+    {
+        policy.setDepth(depth + 1);
+        int move = policy.chooseMove(game, random);
+        if(policy.wasStopped())
+            break;
+
+        ++depth;
+        bestMove = move;
+        publish(bestMove, depth, false);
+
+        // Forced result found, deeper searches can't change it
+        int score = policy.getScore();
+        if(score >= WIN_SCORE || score <= -WIN_SCORE)
+            break;
+    }
+
+    publish(bestMove, depth, true);
+}
+
+// Out of time or cancelled, the clock is only read every TIME_CHECK_NODES nodes
+bool AIPlayer::shouldStop()
+{
+    if(stopped)
+        return true;
+
+    ++nodeCount;
+    if(searchId.load(std::memory_order_relaxed) != runningId ||
+       (nodeCount % TIME_CHECK_NODES == 0 && std::chrono::steady_clock::now() >= deadline))
+        stopped = true;
+
+    return stopped;
+}
+
+// Results of a cancelled search are never stored over a newer one
+void AIPlayer::publish(int move, int depth, bool finished)
+{
+    uint64_t current = result.load();
+    while(static_cast<uint32_t>(current >> 32) == runningId)
+    {
+        if(result.compare_exchange_weak(current, pack(runningId, move, depth, finished)))
+            return;
+    }
+}
+
+// Bits 0-7 move + 1, 8-15 depth, 16 finished and not yet taken, 17 finished, 32-63 search id
+uint64_t AIPlayer::pack(uint32_t id, int move, int depth, bool finished)
+{
+    uint64_t flags = finished ? (3u << 16) : 0;
+    return (uint64_t(id) << 32) | flags | (uint64_t(depth & 0xFF) << 8) | uint64_t((move + 1) & 0xFF);
+}
@@ -0,0 +1,83 @@
+// Connect 4
+// Computer player header file
+
+#ifndef AI_H
+#define AI_H
+
+#include "connect4.h"
+#include "policy.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+AIPlayer searches on its own thread so the frame loop never waits for it.
+startSearch() hands over a copy of the game and returns at once; the worker
+deepens one ply at a time until the move time runs out and publishes the
+best move after every finished depth. Each depth is a SearchPolicy search
+with a stop check, so the computer plays with the learned evaluator when it
+is given weights. The result is a single atomic word, so polling it each
+frame takes no lock.
+*/
+
+// Computer opponent with iterative deepening under a time budget
+class AIPlayer
+{
+    public:
+        static const int DEFAULT_MOVE_TIME = 500; // Milliseconds per move
+
+        AIPlayer(int moveTimeMs = DEFAULT_MOVE_TIME, const std::string& weightsPath = "");
+        ~AIPlayer();
+
+        AIPlayer(const AIPlayer&) = delete;
+        AIPlayer& operator=(const AIPlayer&) = delete;
+
+        // Search control
+        void startSearch(const Connect4Game& game); // Replaces any search still running
+        void cancel();                              // Drop the current search and its result
+        bool takeMove(int& col);                    // True once when a search has finished, gives its move
+
+        // Setters
+        void setMoveTime(int moveTimeMs);
+
+        // Getters
+        bool isThinking() const;
+        int getBestMove() const; // Best move so far, -1 before the first depth finishes
+        int getDepth() const;    // Deepest finished search
+        int getMoveTime() const;
+
+    private:
+        // Published result: search id (high 32 bits), finished flag, depth and move + 1
+        std::atomic<uint64_t> result;
+        std::atomic<uint32_t> searchId; // Changing it cancels the running search
+        std::atomic<int> moveTime;
+
+        // Job handed to the worker
+        std::thread worker;
+        std::mutex jobLock;
+        std::condition_variable jobReady;
+        Connect4Game job;
+        bool hasJob;
+        bool quit;
+
+        // Worker-only search state
+        SearchPolicy policy;
+        Random random;
+        uint32_t runningId;
+        std::chrono::steady_clock::time_point deadline;
+        unsigned long long nodeCount;
+        bool stopped;
+
+        // Helper methods
+        void workerLoop();
+        void search(const Connect4Game& game);
+        bool shouldStop();
+        void publish(int move, int depth, bool finished);
+        static uint64_t pack(uint32_t id, int move, int depth, bool finished);
+};
+
+#endif
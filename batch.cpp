@@ -0,0 +1,431 @@
+// Connect 4
+// Contains function implementations for the batch position evaluator
+
+#include "batch.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+using Board = Connect4Game;
+static_assert(sizeof(Board::Bitboard) == sizeof(uint64_t), "BoardBatch needs 64-bit boards");
+
+// Board constants shared by every kernel
+static const uint64_t BOTTOM = Board::bottomMask();
+static const uint64_t FULL = Board::boardMask();
+static const uint64_t COLUMN = Board::columnMask(0);
+static const int H = Board::COL_BITS;
+
+
+
+// Scalar kernels (also used for the boards left over after the last full vector)
+//----------------------------------------------------------------------------------------//
+
+static void winnersScalar(const uint64_t* p1, const uint64_t* p2, int8_t* winners, size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; ++i)
+        winners[i] = Board::findWinner(p1[i], p2[i]);
+}
+
+static void legalScalar(const uint64_t* p1, const uint64_t* p2, uint64_t* moves, size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; ++i)
+        moves[i] = ((p1[i] | p2[i]) + BOTTOM) & FULL;
+}
+
+static void dropScalar(uint64_t* p1, uint64_t* p2, uint8_t* counts, const int8_t* cols, uint8_t* played,
+                       size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; ++i)
+    {
+        int col = cols[i];
+        uint64_t cell = 0;
+        if(col >= 0 && col < Board::COLS)
+            cell = ((p1[i] | p2[i]) + (BOTTOM & Board::columnMask(col))) & Board::columnMask(col);
+
+        // Player 1 moves when an even number of pieces is down
+        if(counts[i] % 2 == 0)
+            p1[i] |= cell;
+        else
+            p2[i] |= cell;
+
+        played[i] = cell != 0;
+        counts[i] += played[i];
+    }
+}
+
+
+
+#ifdef BATCH_X86
+
+// SSE2 kernels, 2 boards per register
+//----------------------------------------------------------------------------------------//
+
+// Lanes holding a line of 4 along the direction `shift`
+static inline __m128i runs128(__m128i p, int shift)
+{
+    __m128i pairs = _mm_and_si128(p, _mm_srl_epi64(p, _mm_cvtsi32_si128(shift)));
+    return _mm_and_si128(pairs, _mm_srl_epi64(pairs, _mm_cvtsi32_si128(2 * shift)));
+}
+
+static inline __m128i lines128(__m128i p)
+{
+    return _mm_or_si128(_mm_or_si128(runs128(p, 1), runs128(p, H)),
+                        _mm_or_si128(runs128(p, H + 1), runs128(p, H - 1)));
+}
+
+static void winnersSSE2(const uint64_t* p1, const uint64_t* p2, int8_t* winners, size_t count)
+{
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + i));
+
+        uint64_t line1[2], line2[2], filled[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line1), lines128(a));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line2), lines128(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(filled), _mm_or_si128(a, b));
+
+        for(int lane = 0; lane < 2; ++lane)
+        {
+            if(line1[lane] && line2[lane])
+                winners[i + lane] = Board::findWinner(p1[i + lane], p2[i + lane]); // Both have a line
+            else
+                winners[i + lane] = line1[lane] ? 1 : line2[lane] ? 2 : (filled[lane] == FULL) ? -1 : 0;
+        }
+    }
+
+    winnersScalar(p1, p2, winners, i, count);
+}
+
+static void legalSSE2(const uint64_t* p1, const uint64_t* p2, uint64_t* moves, size_t count)
+{
+    const __m128i bottom = _mm_set1_epi64x(BOTTOM);
+    const __m128i full = _mm_set1_epi64x(FULL);
+
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2)
+    {
+        __m128i filled = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + i)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + i)));
+        __m128i next = _mm_and_si128(_mm_add_epi64(filled, bottom), full);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(moves + i), next);
+    }
+
+    legalScalar(p1, p2, moves, i, count);
+}
+
+static void dropSSE2(uint64_t* p1, uint64_t* p2, uint8_t* counts, const int8_t* cols, uint8_t* played, size_t count)
+{
+    // SSE2 has no per-lane shifts, so column masks come from a table (invalid columns get 0)
+    uint64_t columnTable[256] = {};
+    uint64_t bottomTable[256] = {};
+    for(int col = 0; col < Board::COLS; ++col)
+    {
+        columnTable[col] = Board::columnMask(col);
+        bottomTable[col] = BOTTOM & Board::columnMask(col);
+    }
+
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2)
+    {
+        uint8_t c0 = cols[i], c1 = cols[i + 1];
+        __m128i columns = _mm_set_epi64x(columnTable[c1], columnTable[c0]);
+        __m128i bottoms = _mm_set_epi64x(bottomTable[c1], bottomTable[c0]);
+        __m128i player1 = _mm_set_epi64x(counts[i + 1] % 2 ? 0 : -1, counts[i] % 2 ? 0 : -1);
+
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + i));
+        __m128i cell = _mm_and_si128(_mm_add_epi64(_mm_or_si128(a, b), bottoms), columns);
+
+        a = _mm_or_si128(a, _mm_and_si128(cell, player1));
+        b = _mm_or_si128(b, _mm_andnot_si128(player1, cell));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p1 + i), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p2 + i), b);
+
+        uint64_t cells[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cells), cell);
+        for(int lane = 0; lane < 2; ++lane)
+        {
+            played[i + lane] = cells[lane] != 0;
+            counts[i + lane] += played[i + lane];
+        }
+    }
+
+    dropScalar(p1, p2, counts, cols, played, i, count);
+}
+
+
+
+// AVX2 kernels, 4 boards per register
+//----------------------------------------------------------------------------------------//
+
+__attribute__((target("avx2"))) static inline __m256i runs256(__m256i p, int shift)
+{
+    __m256i pairs = _mm256_and_si256(p, _mm256_srl_epi64(p, _mm_cvtsi32_si128(shift)));
+    return _mm256_and_si256(pairs, _mm256_srl_epi64(pairs, _mm_cvtsi32_si128(2 * shift)));
+}
+
+__attribute__((target("avx2"))) static inline __m256i lines256(__m256i p)
+{
+    return _mm256_or_si256(_mm256_or_si256(runs256(p, 1), runs256(p, H)),
+                           _mm256_or_si256(runs256(p, H + 1), runs256(p, H - 1)));
+}
+
+// One bit per lane, set where the lane is zero
+__attribute__((target("avx2"))) static inline int zeroLanes(__m256i v)
+{
+    return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, _mm256_setzero_si256())));
+}
+
+__attribute__((target("avx2"))) static void winnersAVX2(const uint64_t* p1, const uint64_t* p2, int8_t* winners, size_t count)
+{
+    const __m256i full = _mm256_set1_epi64x(FULL);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p2 + i));
+
+        int has1 = ~zeroLanes(lines256(a)) & 15;
+        int has2 = ~zeroLanes(lines256(b)) & 15;
+        int isFull = zeroLanes(_mm256_xor_si256(_mm256_or_si256(a, b), full));
+
+        for(int lane = 0; lane < 4; ++lane)
+        {
+            int bit = 1 << lane;
+            if(has1 & has2 & bit)
+                winners[i + lane] = Board::findWinner(p1[i + lane], p2[i + lane]); // Both have a line
+            else
+                winners[i + lane] = (has1 & bit) ? 1 : (has2 & bit) ? 2 : (isFull & bit) ? -1 : 0;
+        }
+    }
+
+    winnersScalar(p1, p2, winners, i, count);
+}
+
+__attribute__((target("avx2"))) static void legalAVX2(const uint64_t* p1, const uint64_t* p2, uint64_t* moves, size_t count)
+{
+    const __m256i bottom = _mm256_set1_epi64x(BOTTOM);
+    const __m256i full = _mm256_set1_epi64x(FULL);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256i filled = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + i)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p2 + i)));
+        __m256i next = _mm256_and_si256(_mm256_add_epi64(filled, bottom), full);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(moves + i), next);
+    }
+
+    legalScalar(p1, p2, moves, i, count);
+}
+
+__attribute__((target("avx2"))) static void dropAVX2(uint64_t* p1, uint64_t* p2, uint8_t* counts, const int8_t* cols,
+                                                     uint8_t* played, size_t count)
+{
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i column = _mm256_set1_epi64x(COLUMN);
+    const __m256i minusOne = _mm256_set1_epi64x(-1);
+    const __m256i colCount = _mm256_set1_epi64x(Board::COLS);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        int32_t packedCols, packedCounts;
+        memcpy(&packedCols, cols + i, 4);
+        memcpy(&packedCounts, counts + i, 4);
+        __m256i c = _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(packedCols));
+        __m256i n = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packedCounts));
+
+        // Column masks shifted per lane, zero for columns off the board
+        __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi64(c, minusOne), _mm256_cmpgt_epi64(colCount, c));
+        __m256i shift = _mm256_mullo_epi32(c, _mm256_set1_epi64x(H));
+        __m256i columns = _mm256_and_si256(_mm256_sllv_epi64(column, shift), valid);
+        __m256i bottoms = _mm256_sllv_epi64(one, shift);
+
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p2 + i));
+        __m256i cell = _mm256_and_si256(_mm256_add_epi64(_mm256_or_si256(a, b), bottoms), columns);
+
+        // Player 1 moves when an even number of pieces is down
+        __m256i player1 = _mm256_cmpeq_epi64(_mm256_and_si256(n, one), _mm256_setzero_si256());
+        a = _mm256_or_si256(a, _mm256_and_si256(cell, player1));
+        b = _mm256_or_si256(b, _mm256_andnot_si256(player1, cell));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p1 + i), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p2 + i), b);
+
+        int empty = zeroLanes(cell);
+        for(int lane = 0; lane < 4; ++lane)
+        {
+            played[i + lane] = !(empty & (1 << lane));
+            counts[i + lane] += played[i + lane];
+        }
+    }
+
+    dropScalar(p1, p2, counts, cols, played, i, count);
+}
+
+#endif
+
+
+
+BoardBatch::BoardBatch(): kernel(Kernel::Auto)
+{
+}
+
+
+
+// Boards
+//----------------------------------------------------------------------------------------//
+
+void BoardBatch::add(const Connect4Game& game)
+{
+    player1.push_back(game.getPlayerPieces(Connect4Game::PLAYER1));
+    player2.push_back(game.getPlayerPieces(Connect4Game::PLAYER2));
+    moveCounts.push_back(game.getMoveCount());
+}
+
+void BoardBatch::clear()
+{
+    player1.clear();
+    player2.clear();
+    moveCounts.clear();
+}
+
+size_t BoardBatch::size() const
+{
+    return player1.size();
+}
+
+
+
+// Batch operations
+//----------------------------------------------------------------------------------------//
+
+void BoardBatch::checkWinners(int8_t* winners) const
+{
+    switch(getKernel())
+    {
+#ifdef BATCH_X86
+        case Kernel::AVX2:
+            winnersAVX2(player1.data(), player2.data(), winners, size());
+            break;
+        case Kernel::SSE2:
+            winnersSSE2(player1.data(), player2.data(), winners, size());
+            break;
+#endif
+        default:
+            winnersScalar(player1.data(), player2.data(), winners, 0, size());
+    }
+}
+
+void BoardBatch::legalMoves(uint64_t* moves) const
+{
+    switch(getKernel())
+    {
+#ifdef BATCH_X86
+        case Kernel::AVX2:
+            legalAVX2(player1.data(), player2.data(), moves, size());
+            break;
+        case Kernel::SSE2:
+            legalSSE2(player1.data(), player2.data(), moves, size());
+            break;
+#endif
+        default:
+            legalScalar(player1.data(), player2.data(), moves, 0, size());
+    }
+}
+
+void BoardBatch::dropPieces(const int8_t* cols, uint8_t* played)
+{
+    switch(getKernel())
+    {
+#ifdef BATCH_X86
+        case Kernel::AVX2:
+            dropAVX2(player1.data(), player2.data(), moveCounts.data(), cols, played, size());
+            break;
+        case Kernel::SSE2:
+            dropSSE2(player1.data(), player2.data(), moveCounts.data(), cols, played, size());
+            break;
+#endif
+        default:
+            dropScalar(player1.data(), player2.data(), moveCounts.data(), cols, played, 0, size());
+    }
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+uint64_t BoardBatch::getPlayerPieces(size_t board, int player) const
+{
+    return (player == Connect4Game::PLAYER1) ? player1[board] : player2[board];
+}
+
+int BoardBatch::getMoveCount(size_t board) const
+{
+    return moveCounts[board];
+}
+
+
+
+// Kernel selection
+//----------------------------------------------------------------------------------------//
+
+// Ask for a kernel, falling back to the best supported one if this CPU lacks it
+void BoardBatch::setKernel(Kernel requested)
+{
+    kernel = requested;
+}
+
+BoardBatch::Kernel BoardBatch::getKernel() const
+{
+    Kernel best = bestKernel();
+    if(kernel == Kernel::Auto || static_cast<int>(kernel) > static_cast<int>(best))
+        return best;
+
+    return kernel;
+}
+
+BoardBatch::Kernel BoardBatch::bestKernel()
+{
+#ifdef BATCH_X86
+    static const Kernel best = __builtin_cpu_supports("avx2") ? Kernel::AVX2 : Kernel::SSE2;
+    return best;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+const char* BoardBatch::getKernelName(Kernel kernel)
+{
+    switch(kernel)
+    {
+        case Kernel::Scalar:
+            return "scalar";
+        case Kernel::SSE2:
+            return "sse2";
+        case Kernel::AVX2:
+            return "avx2";
+        default:
+            return "auto";
+    }
+}
+
+int BoardBatch::legalColumns(uint64_t moves)
+{
+    int columns = 0;
+    for(int col = 0; col < Board::COLS; ++col)
+    {
+        if(moves & Board::columnMask(col))
+            columns |= 1 << col;
+    }
+
+    return columns;
+}
@@ -0,0 +1,59 @@
+// Connect 4
+// Batch position evaluator header file
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "connect4.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+BoardBatch keeps many standard boards as a structure of arrays (all player 1
+masks together, all player 2 masks together, all move counts together) and
+runs one operation over every board at once. On x86 the kernels use AVX2
+(4 boards per instruction) or SSE2 (2 boards), picked at runtime; other
+machines use the scalar kernel. Every kernel gives exactly the results of
+the matching Connect4Game call.
+*/
+
+// Structure-of-arrays container of Connect4Game boards
+class BoardBatch
+{
+    public:
+        enum class Kernel { Auto, Scalar, SSE2, AVX2 };
+
+        BoardBatch();
+
+        // Boards
+        void add(const Connect4Game& game);
+        void clear();
+        size_t size() const;
+
+        // Batch operations, each writes one result per board
+        void checkWinners(int8_t* winners) const;             // 0, 1, 2 or -1 like Connect4Game::checkWinner()
+        void legalMoves(uint64_t* moves) const;               // The cell each legal move would fill
+        void dropPieces(const int8_t* cols, uint8_t* played); // 1 where the move was legal, like dropPiece()
+
+        // Getters
+        uint64_t getPlayerPieces(size_t board, int player) const;
+        int getMoveCount(size_t board) const;
+
+        // Kernel selection (Auto picks the best one this CPU supports)
+        void setKernel(Kernel kernel);
+        Kernel getKernel() const;
+        static Kernel bestKernel();
+        static const char* getKernelName(Kernel kernel);
+
+        // Column bits (bit c set when column c is playable) of a legalMoves() result
+        static int legalColumns(uint64_t moves);
+
+    private:
+        std::vector<uint64_t> player1;
+        std::vector<uint64_t> player2;
+        std::vector<uint8_t> moveCounts;
+        Kernel kernel;
+};
+
+#endif
@@ -0,0 +1,341 @@
+// Connect 4
+// Benchmarks for the game core
+//
+// Every benchmark runs over the same fixed-seed positions, so results can be
+// compared between commits. Each sample times one pass over all positions;
+// ns/op is the mean and the percentiles are taken over the samples.
+//
+// Options:
+//   --format json|csv   output format (default json)
+//   --samples N         samples per benchmark (default 200)
+//   --check             instead of timing, run every BoardBatch kernel this CPU
+//                       supports on the positions and compare each result with
+//                       Connect4Game, exiting with 1 on any mismatch
+
+#include "batch.h"
+#include "mcts.h"
+#include "policy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cout, std::cerr, std::endl;
+
+// A benchmark position with a piece to check for wins and a legal move
+struct BenchPosition
+{
+    Connect4Game game;
+    int pieceRow, pieceCol, piecePlayer;
+    int move;
+};
+
+struct BenchResult
+{
+    std::string name;
+    double nsPerOp;
+    double opsPerSec;
+    double p50, p90, p99;
+    int samples;
+};
+
+const int POSITION_COUNT = 1024;
+const uint64_t SEED = 20240101;
+
+// Keeps results alive so the compiler can't drop the measured calls
+volatile long long sink;
+
+// Unfinished positions reached by random play, with at least one piece on the board
+std::vector<BenchPosition> makePositions()
+{
+    std::vector<BenchPosition> positions;
+    Random random(SEED);
+    RandomPolicy policy;
+
+    while(positions.size() < POSITION_COUNT)
+    {
+        BenchPosition p;
+        int length = 1 + random.nextInt(p.game.getRows() * p.game.getCols() - 2);
+        for(int i = 0; i < length && !p.game.isGameOver(); ++i)
+            p.game.dropPiece(policy.chooseMove(p.game, random));
+        if(p.game.isGameOver())
+            continue;
+
+        do
+        {
+            p.pieceRow = random.nextInt(p.game.getRows());
+            p.pieceCol = random.nextInt(p.game.getCols());
+            p.piecePlayer = p.game.getBoardValue(p.pieceRow, p.pieceCol);
+        } while(p.piecePlayer == Connect4Game::EMPTY);
+
+        p.move = policy.chooseMove(p.game, random);
+        positions.push_back(p);
+    }
+
+    return positions;
+}
+
+// Every kernel must give the Connect4Game results exactly: winners of the positions, then a drop in
+// column i % COLS for board i (full columns included) and the boards and winners after it
+bool checkKernels(const std::vector<BenchPosition>& positions)
+{
+    const int cols = Connect4Game::COLS;
+    std::vector<int8_t> moves(positions.size());
+    std::vector<int8_t> expectedWinners(positions.size());
+    std::vector<uint8_t> expectedPlayed(positions.size());
+    std::vector<Connect4Game> after(positions.size());
+    std::vector<int8_t> expectedAfter(positions.size());
+    for(size_t i = 0; i < positions.size(); ++i)
+    {
+        Connect4Game game = positions[i].game;
+        expectedWinners[i] = game.checkWinner();
+        moves[i] = i % cols;
+        expectedPlayed[i] = game.dropPiece(moves[i]);
+        expectedAfter[i] = game.checkWinner();
+        after[i] = game;
+    }
+
+    bool allMatch = true;
+    for(BoardBatch::Kernel kernel : {BoardBatch::Kernel::Scalar, BoardBatch::Kernel::SSE2, BoardBatch::Kernel::AVX2})
+    {
+        BoardBatch batch;
+        batch.setKernel(kernel);
+        if(batch.getKernel() != kernel)
+            continue;
+        for(const BenchPosition& p : positions)
+            batch.add(p.game);
+
+        std::vector<int8_t> winners(positions.size());
+        std::vector<uint8_t> played(positions.size());
+        size_t mismatches = 0;
+
+        batch.checkWinners(winners.data());
+        for(size_t i = 0; i < positions.size(); ++i)
+            mismatches += winners[i] != expectedWinners[i];
+
+        batch.dropPieces(moves.data(), played.data());
+        batch.checkWinners(winners.data());
+        for(size_t i = 0; i < positions.size(); ++i)
+        {
+            mismatches += played[i] != expectedPlayed[i] || winners[i] != expectedAfter[i] ||
+                          batch.getPlayerPieces(i, 1) != after[i].getPlayerPieces(1) ||
+                          batch.getPlayerPieces(i, 2) != after[i].getPlayerPieces(2) ||
+                          batch.getMoveCount(i) != after[i].getMoveCount();
+        }
+
+        cout << BoardBatch::getKernelName(kernel) << ": " << (mismatches ? "MISMATCH " : "ok ") << mismatches
+             << " of " << 2 * positions.size() << endl;
+        allMatch = allMatch && mismatches == 0;
+    }
+
+    return allMatch;
+}
+
+// Time `samples` passes of `ops` operations; setup runs untimed before each pass
+BenchResult measure(const std::string& name, int samples, int ops, const std::function<void()>& setup,
+                    const std::function<long long()>& pass)
+{
+    std::vector<double> perOp;
+    double total = 0;
+
+    for(int s = 0; s < samples; ++s)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        sink = sink + pass();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        perOp.push_back(elapsed.count() / ops);
+        total += elapsed.count();
+    }
+
+    std::sort(perOp.begin(), perOp.end());
+    auto percentile = [&](double p) { return perOp[static_cast<size_t>(p * (perOp.size() - 1))]; };
+
+    BenchResult result;
+    result.name = name;
+    result.nsPerOp = total / (static_cast<double>(samples) * ops);
+    result.opsPerSec = 1e9 / result.nsPerOp;
+    result.p50 = percentile(0.50);
+    result.p90 = percentile(0.90);
+    result.p99 = percentile(0.99);
+    result.samples = samples;
+
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string format = "json";
+    int samples = 200;
+    bool check = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            format = argv[++i];
+        else if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            samples = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--check") == 0)
+            check = true;
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--format json|csv] [--samples N] [--check]" << endl;
+            return 1;
+        }
+    }
+    if(samples < 1 || (format != "json" && format != "csv"))
+    {
+        cerr << "Usage: " << argv[0] << " [--format json|csv] [--samples N] [--check]" << endl;
+        return 1;
+    }
+
+    const std::vector<BenchPosition> positions = makePositions();
+    if(check)
+        return checkKernels(positions) ? 0 : 1;
+    std::vector<Connect4Game> work(positions.size());
+    auto copyPositions = [&]()
+    {
+        for(size_t i = 0; i < positions.size(); ++i)
+            work[i] = positions[i].game;
+    };
+    auto noSetup = []() {};
+
+    std::vector<BenchResult> results;
+
+    results.push_back(measure("dropPiece", samples, POSITION_COUNT, copyPositions, [&]()
+    {
+        long long n = 0;
+        for(size_t i = 0; i < work.size(); ++i)
+            n += work[i].dropPiece(positions[i].move);
+        return n;
+    }));
+
+    results.push_back(measure("checkWinner", samples, POSITION_COUNT, copyPositions, [&]()
+    {
+        long long n = 0;
+        for(Connect4Game& game : work)
+            n += game.checkWinner();
+        return n;
+    }));
+
+    results.push_back(measure("checkWinFromPosition", samples, POSITION_COUNT, noSetup, [&]()
+    {
+        long long n = 0;
+        for(const BenchPosition& p : positions)
+            n += p.game.checkWinFromPosition(p.pieceRow, p.pieceCol, p.piecePlayer);
+        return n;
+    }));
+
+    results.push_back(measure("isBoardFull", samples, POSITION_COUNT, noSetup, [&]()
+    {
+        long long n = 0;
+        for(const BenchPosition& p : positions)
+            n += p.game.isBoardFull();
+        return n;
+    }));
+
+    results.push_back(measure("resetGame", samples, POSITION_COUNT, copyPositions, [&]()
+    {
+        long long n = 0;
+        for(Connect4Game& game : work)
+        {
+            game.resetGame();
+            n += game.getCurrentPlayer();
+        }
+        return n;
+    }));
+
+    // The same checks and drops over all positions at once, for each kernel this CPU supports
+    std::vector<int8_t> winners(positions.size());
+    std::vector<int8_t> moves(positions.size());
+    std::vector<uint8_t> played(positions.size());
+    for(size_t i = 0; i < positions.size(); ++i)
+        moves[i] = positions[i].move;
+
+    BoardBatch batch;
+    auto fillBatch = [&]()
+    {
+        batch.clear();
+        for(const BenchPosition& p : positions)
+            batch.add(p.game);
+    };
+    fillBatch();
+
+    for(BoardBatch::Kernel kernel : {BoardBatch::Kernel::Scalar, BoardBatch::Kernel::SSE2, BoardBatch::Kernel::AVX2})
+    {
+        batch.setKernel(kernel);
+        if(batch.getKernel() != kernel)
+            continue;
+        std::string suffix = std::string("/") + BoardBatch::getKernelName(kernel);
+
+        results.push_back(measure("batchCheckWinners" + suffix, samples, POSITION_COUNT, noSetup, [&]()
+        {
+            batch.checkWinners(winners.data());
+            return static_cast<long long>(winners[0]);
+        }));
+
+        results.push_back(measure("batchDropPieces" + suffix, samples, POSITION_COUNT, fillBatch, [&]()
+        {
+            batch.dropPieces(moves.data(), played.data());
+            return static_cast<long long>(played[0]);
+        }));
+    }
+
+    // Whole games from the empty board, same games in every sample
+    const int playouts = 256;
+    Random random(SEED);
+    RandomPolicy policy;
+    results.push_back(measure("randomPlayout", samples, playouts, [&]() { random = Random(SEED); }, [&]()
+    {
+        long long n = 0;
+        Connect4Game game;
+        for(int i = 0; i < playouts; ++i)
+        {
+            game.resetGame();
+            while(!game.isGameOver())
+                game.dropPiece(policy.chooseMove(game, random));
+            n += game.getWinner();
+        }
+        return n;
+    }));
+
+    // Tree search playouts from the empty board, each sample grows a fresh tree
+    const int treePlayouts = 2000;
+    MCTSPlayer mcts(1, MCTSPlayer::DEFAULT_CAPACITY, SEED);
+    Connect4Game empty;
+    results.push_back(measure("mctsPlayout", samples, treePlayouts, [&]() { mcts.reset(empty); }, [&]()
+    {
+        return static_cast<long long>(mcts.search(empty, 0, treePlayouts));
+    }));
+
+    if(format == "csv")
+    {
+        cout << "name,ns_per_op,ops_per_sec,p50_ns,p90_ns,p99_ns,samples" << endl;
+        for(const BenchResult& r : results)
+        {
+            cout << r.name << "," << r.nsPerOp << "," << r.opsPerSec << "," << r.p50 << ","
+                 << r.p90 << "," << r.p99 << "," << r.samples << endl;
+        }
+    }
+    else
+    {
+        cout << "{\n  \"seed\": " << SEED << ",\n  \"positions\": " << POSITION_COUNT
+             << ",\n  \"mcts_bytes_per_node\": " << sizeof(MCTSNode) << ",\n  \"benchmarks\": [" << endl;
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchResult& r = results[i];
+            cout << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.nsPerOp
+                 << ", \"ops_per_sec\": " << r.opsPerSec << ", \"p50_ns\": " << r.p50
+                 << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99
+                 << ", \"samples\": " << r.samples << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        cout << "  ]\n}" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+// Connect 4
+// Contains function implementations for the opening book
+
+#include "book.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+OpeningBook::OpeningBook(): mapping(nullptr), mappingSize(0), header(nullptr), entries(nullptr)
+{
+}
+
+OpeningBook::~OpeningBook()
+{
+    close();
+}
+
+
+
+// File handling
+//----------------------------------------------------------------------------------------//
+
+// Map a book file into memory, returns false if it is missing or not a valid book
+bool OpeningBook::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // The mapping stays valid after the file is closed
+    if(data == MAP_FAILED)
+        return false;
+
+    const Header* fileHeader = static_cast<const Header*>(data);
+    bool valid = memcmp(fileHeader->magic, "C4BK", 4) == 0 && fileHeader->version == VERSION &&
+                 info.st_size == static_cast<off_t>(sizeof(Header) + fileHeader->count * sizeof(uint64_t));
+    if(!valid)
+    {
+        munmap(data, info.st_size);
+        return false;
+    }
+
+    mapping = data;
+    mappingSize = info.st_size;
+    header = fileHeader;
+    entries = reinterpret_cast<const uint64_t*>(fileHeader + 1);
+
+    return true;
+}
+
+// Unmap the book
+void OpeningBook::close()
+{
+    if(mapping)
+        munmap(mapping, mappingSize);
+
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    entries = nullptr;
+}
+
+// Sort and pack solved positions into a book file
+bool OpeningBook::write(const std::string& path, int rows, int cols, int plies, std::vector<BookEntry> positions,
+                        int minPlies)
+{
+    if(cols > 8)
+        return false; // Moves are packed into 3 bits
+
+    std::vector<uint64_t> packed;
+    packed.reserve(positions.size());
+    for(const BookEntry& entry : positions)
+    {
+        if(entry.key >> 55)
+            return false;
+        packed.push_back(entry.key << 9 | static_cast<uint64_t>(entry.score + 32) << 3 | (entry.bestMove & 7));
+    }
+    std::sort(packed.begin(), packed.end());
+
+    Header fileHeader = {};
+    memcpy(fileHeader.magic, "C4BK", 4);
+    fileHeader.version = VERSION;
+    fileHeader.rows = rows;
+    fileHeader.cols = cols;
+    fileHeader.plies = plies;
+    fileHeader.minPlies = minPlies;
+    fileHeader.count = packed.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    file.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(uint64_t));
+
+    return static_cast<bool>(file);
+}
+
+
+
+// Lookup
+//----------------------------------------------------------------------------------------//
+
+// Binary search for a position, returns false if it is not in the book
+bool OpeningBook::lookup(uint64_t key, int& score, int& bestMove) const
+{
+    if(!entries)
+        return false;
+
+    uint64_t low = 0;
+    uint64_t high = header->count;
+    while(low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        uint64_t entryKey = entries[mid] >> 9;
+
+        if(entryKey < key)
+            low = mid + 1;
+        else if(entryKey > key)
+            high = mid;
+        else
+        {
+            score = static_cast<int>((entries[mid] >> 3) & 63) - 32;
+            bestMove = static_cast<int>(entries[mid] & 7);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+bool OpeningBook::isOpen() const
+{
+    return header != nullptr;
+}
+
+int OpeningBook::getRows() const
+{
+    return header ? header->rows : 0;
+}
+
+int OpeningBook::getCols() const
+{
+    return header ? header->cols : 0;
+}
+
+int OpeningBook::getPlies() const
+{
+    return header ? header->plies : 0;
+}
+
+int OpeningBook::getMinPlies() const
+{
+    return header ? header->minPlies : 0;
+}
+
+uint64_t OpeningBook::getEntryCount() const
+{
+    return header ? header->count : 0;
+}
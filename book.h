@@ -0,0 +1,79 @@
+// Connect 4
+// Opening book header file
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One solved position, as handed to OpeningBook::write()
+struct BookEntry
+{
+    uint64_t key;  // Connect4Game::getCanonicalKey()
+    int score;
+    int bestMove;
+};
+
+/*
+Book file layout (native byte order):
+  header  "C4BK", version, rows, cols, last ply, first ply, entry count
+  entries one 64-bit word each, sorted: key << 9 | (score + 32) << 3 | bestMove
+
+Keys must fit in 55 bits and boards may have at most 8 columns. Positions
+are stored under their canonical key with the best move in the canonical
+orientation, so a position and its mirror image share one entry.
+The file is memory mapped read-only, so every process using the same book
+shares one copy of it and opening it costs no parsing.
+
+Opening books cover plies 0 up to the last ply; endgame tables use the same
+file with the first ply set to where they start.
+*/
+
+// Read-only table of solved early game positions
+class OpeningBook
+{
+    public:
+        OpeningBook();
+        ~OpeningBook();
+        OpeningBook(const OpeningBook&) = delete;
+        OpeningBook& operator=(const OpeningBook&) = delete;
+
+        // File handling
+        bool open(const std::string& path);
+        void close();
+        static bool write(const std::string& path, int rows, int cols, int plies, std::vector<BookEntry> entries,
+                          int minPlies = 0);
+
+        // Lookup
+        bool lookup(uint64_t key, int& score, int& bestMove) const;
+
+        // Getters
+        bool isOpen() const;
+        int getRows() const;
+        int getCols() const;
+        int getPlies() const;    // Deepest position stored
+        int getMinPlies() const; // Shallowest position stored (0 for opening books)
+        uint64_t getEntryCount() const;
+
+    private:
+        struct Header
+        {
+            char magic[4];
+            uint32_t version;
+            uint8_t rows, cols, plies, minPlies;
+            uint32_t reserved;
+            uint64_t count;
+        };
+
+        static const uint32_t VERSION = 2; // 2: canonical keys
+
+        void* mapping;
+        size_t mappingSize;
+        const Header* header;
+        const uint64_t* entries;
+};
+
+#endif
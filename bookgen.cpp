@@ -0,0 +1,115 @@
+// Connect 4
+// Opening book generator: solves every position up to N plies and writes a book file
+//
+// Options:
+//   -d N     deepest ply to include (default 6)
+//   -t N     worker threads (default: all hardware threads)
+//   -o path  output file (default connect4.book)
+
+#include "solver.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+
+using std::cout, std::cerr, std::endl;
+
+// Every distinct unfinished position reachable in up to maxPlies moves, shallowest first.
+// Mirror images count as the same position, the book only stores one of them
+std::vector<Connect4Game> enumeratePositions(int maxPlies)
+{
+    std::vector<Connect4Game> positions(1);
+    size_t layerStart = 0;
+
+    for(int ply = 0; ply < maxPlies; ++ply)
+    {
+        size_t layerEnd = positions.size();
+        std::unordered_set<uint64_t> seen;
+
+        for(size_t i = layerStart; i < layerEnd; ++i)
+        {
+            for(int col = 0; col < positions[i].getCols(); ++col)
+            {
+                Connect4Game next = positions[i];
+                if(!next.dropPiece(col) || next.isGameOver())
+                    continue;
+
+                if(seen.insert(next.getCanonicalKey()).second)
+                    positions.push_back(next);
+            }
+        }
+
+        layerStart = layerEnd;
+    }
+
+    return positions;
+}
+
+int main(int argc, char* argv[])
+{
+    int plies = 6;
+    int threads = std::thread::hardware_concurrency();
+    std::string path = "connect4.book";
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            plies = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            path = argv[++i];
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-d plies] [-t threads] [-o book]" << endl;
+            return 1;
+        }
+    }
+    if(threads < 1)
+        threads = 1;
+
+    std::vector<Connect4Game> positions = enumeratePositions(plies);
+    cerr << positions.size() << " positions up to " << plies << " plies" << endl;
+
+    // Deep positions are cheap and warm the shared table for the shallow ones
+    TranspositionTable table;
+    std::vector<BookEntry> entries(positions.size());
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> solved(0);
+
+    auto worker = [&]()
+    {
+        Connect4Solver solver(&table);
+        for(size_t i = next++; i < positions.size(); i = next++)
+        {
+            const Connect4Game& game = positions[positions.size() - 1 - i];
+            SolverResult result = solver.solve(game);
+            bool mirrored;
+            uint64_t key = game.getCanonicalKey(mirrored);
+            int move = mirrored ? Connect4Game::mirrorColumn(result.bestMove) : result.bestMove;
+            entries[i] = BookEntry{key, result.score, move};
+
+            size_t done = ++solved;
+            if(done % 1000 == 0)
+                cerr << done << " / " << positions.size() << " solved" << endl;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i)
+        workers.emplace_back(worker);
+    for(std::thread& w : workers)
+        w.join();
+
+    Connect4Game empty;
+    if(!OpeningBook::write(path, empty.getRows(), empty.getCols(), plies, entries))
+    {
+        cerr << "Could not write " << path << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << entries.size() << " positions to " << path << endl;
+    return 0;
+}
@@ -2,22 +2,13 @@
 // Contains function implementations for the connect 4 game
 
 #include "connect4.h"
+#include "perf.h"
 
 // Connect 4 Game Constructor
-Connect4Game::Connect4Game()
+template<int Rows, int Cols, int Connect>
+BasicConnect4Game<Rows, Cols, Connect>::BasicConnect4Game(): version(0)
 {
-    // Initialize the board to all empty
-    for(int row = 0; row < ROWS; ++row)
-    {
-        for(int col = 0; col < COLS; ++col)
-        {
-            board[row][col] = EMPTY;
-        }
-    }
-
-    currentPlayer = PLAYER1;  // Player 1 starts
-    gameOver = false;
-    winner = 0;
+    resetGame();
 }
 
 
@@ -26,30 +17,33 @@ Connect4Game::Connect4Game()
 // Game logic
 
 // Attempt to drop a piece while checking for game ending conditions
-bool Connect4Game::dropPiece(int col)
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::dropPiece(int col)
 {
+    PERF_COUNT(Drops);
+
     // Check if column is valid
     if(col < 0 || col >= COLS)
         return false;
-    
+
     // Check if column is full
     if(isColumnFull(col))
         return false;
-    
-    // Find the lowest empty row in this column
-    int targetRow = -1;
-    for(int row = ROWS - 1; row >= 0; --row)
-    {
-        if(board[row][col] == EMPTY)
-        {
-            targetRow = row;
-            break;
-        }
-    }
-    
+
+    // The lowest empty row sits right above the pieces already in this column
+    int targetRow = ROWS - 1 - heights[col];
+
+    // Remember how to take the move back
+    history[moveCount] = MoveRecord{static_cast<int8_t>(col), static_cast<int8_t>(winner), gameOver};
+
     // Place the piece
-    board[targetRow][col] = currentPlayer;
-    
+    boards[currentPlayer - 1] |= cellBit(targetRow, col);
+    mirrorBoards[currentPlayer - 1] |= cellBit(targetRow, mirrorColumn(col));
+    hash ^= ZOBRIST_KEYS[(currentPlayer - 1) * COL_BITS * COLS + col * COL_BITS + heights[col]];
+    ++heights[col];
+    ++moveCount;
+    ++version;
+
     // Check if this move wins the game
     if(checkWinFromPosition(targetRow, col, currentPlayer))
     {
@@ -61,81 +55,167 @@ bool Connect4Game::dropPiece(int col)
         gameOver = true;
         winner = -1; // Tie game
     }
-    
+
     // Switch to the other player
     currentPlayer = (currentPlayer == PLAYER1) ? PLAYER2 : PLAYER1;
-    
+
+    return true;
+}
+
+// Take back the last move, restoring the game state from before it
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::undoMove()
+{
+    if(moveCount == 0)
+        return false;
+
+    const MoveRecord& move = history[--moveCount];
+    int row = ROWS - heights[move.col];
+    --heights[move.col];
+
+    // The piece belongs to the player who moved before the current one
+    currentPlayer = (currentPlayer == PLAYER1) ? PLAYER2 : PLAYER1;
+    boards[currentPlayer - 1] &= ~cellBit(row, move.col);
+    mirrorBoards[currentPlayer - 1] &= ~cellBit(row, mirrorColumn(move.col));
+    hash ^= ZOBRIST_KEYS[(currentPlayer - 1) * COL_BITS * COLS + move.col * COL_BITS + heights[move.col]];
+
+    winner = move.winner;
+    gameOver = move.gameOver;
+    ++version;
+
+    return true;
+}
+
+// Play a string of columns numbered from 1 (e.g. "4453")
+// If any move is invalid or comes after the game ended, nothing is played
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::playSequence(const std::string& moves)
+{
+    int played = 0;
+
+    for(char c : moves)
+    {
+        if(isGameOver() || !dropPiece(c - '1'))
+        {
+            while(played-- > 0)
+                undoMove();
+            return false;
+        }
+        ++played;
+    }
+
     return true;
 }
 
 // Search the entire board for any winning combinations
-int Connect4Game::checkWinner()
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::checkWinner()
+{
+    PERF_COUNT(WinChecks);
+    int result = findWinner(boards[0], boards[1]);
+
+    // Record a winner (1 or 2) or a tie (-1)
+    if(result != 0)
+    {
+        winner = result;
+        gameOver = true;
+    }
+
+    return result;
+}
+
+// Winner of a board given as two sets of pieces: 1 or 2, -1 for a full board
+// with no line (tie) and 0 while the game is still going
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::findWinner(Bitboard pieces1, Bitboard pieces2)
 {
-    // Loop through 2d array
-    for(int row = 0; row < ROWS; ++row)
+    Bitboard lines1 = winningCells(pieces1);
+    Bitboard lines2 = winningCells(pieces2);
+
+    if(lines1 || lines2)
     {
-        for(int col = 0; col < COLS; ++col)
+        int player = lines1 ? PLAYER1 : PLAYER2;
+
+        // Pieces dropped after the game ended can give both players a line,
+        // report the one found first reading the board from the top left
+        if(lines1 && lines2)
         {
-            if(board[row][col] != EMPTY) // Found a piece
+            for(int row = 0; row < ROWS; ++row)
             {
-                int player = board[row][col]; // Get player number of that piece
-                if(checkWinFromPosition(row, col, player)) // Check for a winning condition
+                Bitboard rowMask = 0;
+                for(int col = 0; col < COLS; ++col)
+                    rowMask |= cellBit(row, col);
+
+                Bitboard row1 = lines1 & rowMask;
+                Bitboard row2 = lines2 & rowMask;
+                if(row1 || row2)
                 {
-                    winner = player;
-                    gameOver = true;
-                    return player; // Return winning player
+                    bool firstIsP1 = row1 && (!row2 || lowestCol(row1) < lowestCol(row2));
+                    player = firstIsP1 ? PLAYER1 : PLAYER2;
+                    break;
                 }
             }
         }
+
+        return player; // Return winning player
     }
 
     // Check tie
-    if(isBoardFull()) 
-    {
-        winner = -1;  // Set tie
-        gameOver = true;
+    if((pieces1 | pieces2) == boardMask())
         return -1;
-    }
-    
+
     // No winner yet
     return 0;
 }
 
+// Check for 4 in a row in all directions through one piece
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::checkWinFromPosition(int row, int col, int player) const
+{
+    PERF_COUNT(WinChecks);
+    if(player != PLAYER1 && player != PLAYER2)
+        return false;
+
+    Bitboard pieces = boards[player - 1];
+    Bitboard cell = cellBit(row, col);
+
+    return (pieces & cell) && (winningCells(pieces) & cell);
+}
+
 // This function is used by dropPiece() to check if a move is legal before attempting it
-bool Connect4Game::isColumnFull(int col) const
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::isColumnFull(int col) const
 {
     // Check if column is valid
     if(col < 0 || col >= COLS)
         return true; // Treat invalid columns as "full" instead of crashing program
-    
-    // Check if the top row of this column has a piece
-    return board[0][col] != EMPTY;
+
+    // Check if this column already holds a piece in every row
+    return heights[col] >= ROWS;
 }
 
 // This function is used by checkWinner() to verify a tie condition
-bool Connect4Game::isBoardFull() const
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::isBoardFull() const
 {
-    // Check if all columns are full
-    for(int col = 0; col < COLS; ++col)
-    {
-        if(!isColumnFull(col))
-            return false; // Found at least one column that's not full
-    }
-    
-    return true; // All columns are full
+    // Every move fills exactly one cell
+    return moveCount >= ROWS * COLS;
 }
 
 // Reset Game
-void Connect4Game::resetGame()
+template<int Rows, int Cols, int Connect>
+void BasicConnect4Game<Rows, Cols, Connect>::resetGame()
 {
     // Clear the entire board
-    for(int row = 0; row < ROWS; ++row)
-    {
-        for(int col = 0; col < COLS; ++col)
-        {
-            board[row][col] = EMPTY;
-        }
-    }
+    boards[0] = 0;
+    boards[1] = 0;
+    mirrorBoards[0] = 0;
+    mirrorBoards[1] = 0;
+    for(int col = 0; col < COLS; ++col)
+        heights[col] = 0;
+    moveCount = 0;
+    hash = 0;
+    ++version; // Never reset, so a redrawn board is never mistaken for an older one
 
     // Reset game state
     currentPlayer = PLAYER1;
@@ -149,30 +229,208 @@ void Connect4Game::resetGame()
 // Getters
 
 // Get Board Value
-int Connect4Game::getBoardValue(int row, int col) const
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getBoardValue(int row, int col) const
 {
-    // Check bounds to prevent array access errors
+    // Check bounds to prevent invalid shifts
     if(row < 0 || row >= ROWS || col < 0 || col >= COLS)
         return -1; // Invalid position
 
-    return board[row][col]; // either 0, 1, or 2
+    Bitboard cell = cellBit(row, col);
+    if(boards[0] & cell)
+        return PLAYER1;
+    if(boards[1] & cell)
+        return PLAYER2;
+
+    return EMPTY;
 }
 
-int Connect4Game::getCurrentPlayer() const
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getCurrentPlayer() const
 {
     return currentPlayer;
 }
 
-bool Connect4Game::isGameOver() const
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::isGameOver() const
 {
     return (getWinner() != 0) || isBoardFull();
 }
 
-int Connect4Game::getWinner() const
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getWinner() const
 {
     return winner;  // Return current winner value (0, 1, 2, -1)
 }
 
+template<int Rows, int Cols, int Connect>
+unsigned BasicConnect4Game<Rows, Cols, Connect>::getVersion() const
+{
+    return version;
+}
+
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getMove(int index) const
+{
+    if(index < 0 || index >= moveCount)
+        return -1;
+
+    return history[index].col;
+}
+
+// All pieces of one player
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getPlayerPieces(int player) const
+{
+    return (player == PLAYER1 || player == PLAYER2) ? boards[player - 1] : 0;
+}
+
+// Adding the column's bottom bit carries up to its first empty cell, a full column carries into the spare bit
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::dropCell(Bitboard occupied, int col)
+{
+    return (occupied + (bottomMask() & columnMask(col))) & columnMask(col);
+}
+
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::hasLine(Bitboard pieces)
+{
+    return hasConnection(pieces);
+}
+
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::threatCells(Bitboard pieces, Bitboard occupied)
+{
+    return completingCells(pieces) & ((occupied + bottomMask()) & boardMask());
+}
+
+
+
+//----------------------------------------------------------------------------------------//
+// Search support
+
+// Number of pieces on the board
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getMoveCount() const
+{
+    return moveCount;
+}
+
+// Would dropping a piece in this column win the game for the current player
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::isWinningMove(int col) const
+{
+    PERF_COUNT(WinChecks);
+    if(gameOver || isColumnFull(col))
+        return false;
+
+    Bitboard pieces = boards[currentPlayer - 1] | cellBit(ROWS - 1 - heights[col], col);
+    return hasConnection(pieces);
+}
+
+// Empty cells where the current player would complete a line
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getWinningCells() const
+{
+    return completingCells(boards[currentPlayer - 1]) & ~(boards[0] | boards[1]);
+}
+
+// Lets a search rank moves by the threats they create without playing them
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getWinningCellsAfter(Bitboard cell) const
+{
+    return completingCells(boards[currentPlayer - 1] | cell) & ~(boards[0] | boards[1] | cell);
+}
+
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getOpponentWinningCells() const
+{
+    return completingCells(boards[2 - currentPlayer]) & ~(boards[0] | boards[1]);
+}
+
+// Adding the bottom row carries each column up to its first empty cell
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getPlayableCells() const
+{
+    return ((boards[0] | boards[1]) + bottomMask()) & boardMask();
+}
+
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::canWinNext() const
+{
+    return !gameOver && (getWinningCells() & getPlayableCells()) != 0;
+}
+
+// A playable opponent win must be blocked (two can't be), and no move may
+// go directly under an opponent win, as that makes the cell playable
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getNonLosingMoves() const
+{
+    Bitboard possible = getPlayableCells();
+    Bitboard opponentWins = getOpponentWinningCells();
+    Bitboard forced = possible & opponentWins;
+
+    if(forced)
+    {
+        if(forced & (forced - 1))
+            return 0;
+        possible = forced;
+    }
+
+    return possible & ~(opponentWins >> 1);
+}
+
+// Unique key for the position: the current player's pieces plus the filled cells
+// shifted up by one, which leaves a single marker bit on top of every column
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getPositionKey() const
+{
+    Bitboard filled = boards[0] | boards[1];
+    return boards[currentPlayer - 1] + filled + bottomMask();
+}
+
+// Same encoding as getPositionKey() for the mirror image, kept up to date by every move
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getMirroredKey() const
+{
+    Bitboard filled = mirrorBoards[0] | mirrorBoards[1];
+    return mirrorBoards[currentPlayer - 1] + filled + bottomMask();
+}
+
+// Store positions under this key to keep one entry per mirrored pair
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getCanonicalKey() const
+{
+    bool mirrored;
+    return getCanonicalKey(mirrored);
+}
+
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::getCanonicalKey(bool& mirrored) const
+{
+    Bitboard key = getPositionKey();
+    Bitboard mirrorKey = getMirroredKey();
+    mirrored = mirrorKey < key;
+
+    return mirrored ? mirrorKey : key;
+}
+
+// Column as seen in the mirror image (maps moves both ways)
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::mirrorColumn(int col)
+{
+    return COLS - 1 - col;
+}
+
+// 64-bit hash of the position, updated by dropPiece()/undoMove() instead of rebuilt.
+// Equal positions always hash the same but different ones can collide, so use
+// getPositionKey() where a collision would be wrong
+template<int Rows, int Cols, int Connect>
+uint64_t BasicConnect4Game<Rows, Cols, Connect>::getHash() const
+{
+    return hash;
+}
+
 
 
 //----------------------------------------------------------------------------------------//
@@ -181,7 +439,7 @@ int Connect4Game::getWinner() const
 /*
 Connect4 Board Layout (6 rows x 7 columns):
 
-     0   1   2   3   4   5   6  
+     0   1   2   3   4   5   6
    +---+---+---+---+---+---+---+
 0  | . | . | . | . | . | . | . |
    +---+---+---+---+---+---+---+
@@ -196,96 +454,160 @@ Connect4 Board Layout (6 rows x 7 columns):
 5  | . | . | . | . | . | . | . |
    +---+---+---+---+---+---+---+
 
-Traversal Directions:
-Horizontal    (-): left (--col), right (++col)
-Vertical      (|): up (--row), down (++row)  
-Diagonal Up   (/): down-left (++row,--col), up-right (--row,++col)
-Diagonal Down (\): up-left (--row,--col), down-right (++row,++col)
-*/
-
-// Check for a win horizontally from the location of the dropped piece
-// Add the consecutive player pieces in both directions. Total >= 4 is a win
-bool Connect4Game::checkHorizontal(int row, int col, int player) const
-{
-    int count = 1; // Count the piece we're starting from
+Bitboard Layout (bit index of every cell):
 
-    // Check to the left
-    for(int c = col - 1; c >= 0 && board[row][c] == player; --c)
-        ++count;
+     0   1   2   3   4   5   6
+   +---+---+---+---+---+---+---+
+   | 6 |13 |20 |27 |34 |41 |48 |  <- spare bit, always empty
+   +---+---+---+---+---+---+---+
+0  | 5 |12 |19 |26 |33 |40 |47 |
+1  | 4 |11 |18 |25 |32 |39 |46 |
+2  | 3 |10 |17 |24 |31 |38 |45 |
+3  | 2 | 9 |16 |23 |30 |37 |44 |
+4  | 1 | 8 |15 |22 |29 |36 |43 |
+5  | 0 | 7 |14 |21 |28 |35 |42 |
+   +---+---+---+---+---+---+---+
 
-    // Check to the right
-    for(int c = col + 1; c < COLS && board[row][c] == player; ++c)
-        ++count;
+Shift Directions (the spare bit stops lines wrapping between columns):
+Vertical      (|): 1
+Horizontal    (-): ROWS + 1
+Diagonal Up   (/): ROWS + 2
+Diagonal Down (\): ROWS
+*/
 
-    return count >= 4;
+// Lowest cell of every run of Length pieces along one direction,
+// built by doubling so 4 in a row takes two shifts
+template<int Rows, int Cols, int Connect>
+template<int Shift, int Length>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::runStarts(Bitboard pieces)
+{
+    if constexpr(Length == 1)
+        return pieces;
+    else
+    {
+        Bitboard half = runStarts<Shift, Length / 2>(pieces);
+        Bitboard runs = half & (half >> ((Length / 2) * Shift));
+        if constexpr(Length % 2 == 1)
+            runs &= pieces >> ((Length - 1) * Shift);
+        return runs;
+    }
 }
 
-// Check for a win vertically from the location of the dropped piece
-bool Connect4Game::checkVertical(int row, int col, int player) const
+// Spread the lowest cell of each run over the whole run
+template<int Rows, int Cols, int Connect>
+template<int Shift, int Length>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::spreadRuns(Bitboard starts)
 {
-    int count = 1; // Count the piece we're starting from
-
-    // Check upward
-    for(int r = row - 1; r >= 0 && board[r][col] == player; --r)
-        ++count;
-
-    // Check downward
-    for(int r = row + 1; r < ROWS && board[r][col] == player; ++r)
-        ++count;
-
-    return count >= 4;
+    if constexpr(Length == 1)
+        return starts;
+    else
+    {
+        Bitboard half = spreadRuns<Shift, Length / 2>(starts);
+        Bitboard cells = half | (half << ((Length / 2) * Shift));
+        if constexpr(Length % 2 == 1)
+            cells |= starts << ((Length - 1) * Shift);
+        return cells;
+    }
 }
 
-// Check for a win diagonally up-right and down-left from the location of the dropped piece
-bool Connect4Game::checkDiagonalUp(int row, int col, int player) const
+// Check a set of pieces for CONNECT in a row in any direction
+template<int Rows, int Cols, int Connect>
+bool BasicConnect4Game<Rows, Cols, Connect>::hasConnection(Bitboard pieces)
 {
-    int count = 1; // Count the piece we're starting from
-
-    // Check down-left direction
-    for(int r = row + 1, c = col - 1; r < ROWS && c >= 0 && board[r][c] == player; ++r, --c)
-        ++count;
-
-    // Check up-right direction
-    for(int r = row - 1, c = col + 1; r >= 0 && c < COLS && board[r][c] == player; --r, ++c)
-        ++count;
-
-    return count >= 4;
+    return (runStarts<1, CONNECT>(pieces) |                // Vertical
+            runStarts<COL_BITS, CONNECT>(pieces) |         // Horizontal
+            runStarts<COL_BITS + 1, CONNECT>(pieces) |     // Diagonal up
+            runStarts<COL_BITS - 1, CONNECT>(pieces)) != 0; // Diagonal down
 }
 
-// Check for a win diagonally up-left and down-right from the location of the dropped piece
-bool Connect4Game::checkDiagonalDown(int row, int col, int player) const
+// Every cell that is part of a line of CONNECT pieces
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::winningCells(Bitboard pieces)
 {
-    int count = 1; // Count the piece we're starting from
+    return spreadRuns<1, CONNECT>(runStarts<1, CONNECT>(pieces)) |
+           spreadRuns<COL_BITS, CONNECT>(runStarts<COL_BITS, CONNECT>(pieces)) |
+           spreadRuns<COL_BITS + 1, CONNECT>(runStarts<COL_BITS + 1, CONNECT>(pieces)) |
+           spreadRuns<COL_BITS - 1, CONNECT>(runStarts<COL_BITS - 1, CONNECT>(pieces));
+}
 
-    // Check up-left direction
-    for(int r = row - 1, c = col - 1; r >= 0 && c >= 0 && board[r][c] == player; --r, --c)
-        ++count;
+// Cells that complete a line along one direction when the other CONNECT - 1
+// cells of the line hold pieces, for each place the gap can take in the line
+template<int Rows, int Cols, int Connect>
+template<int Shift>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::lineGaps(Bitboard pieces)
+{
+    // Four in a row shares the pairs on each side of the gap
+    if constexpr(Connect == 4)
+    {
+        Bitboard below = (pieces << Shift) & (pieces << (2 * Shift));
+        Bitboard above = (pieces >> Shift) & (pieces >> (2 * Shift));
+        return (below & (pieces << (3 * Shift))) | (below & (pieces >> Shift)) |
+               (above & (pieces << Shift)) | (above & (pieces >> (3 * Shift)));
+    }
+    else
+    {
+        Bitboard cells = 0;
+        for(int gap = 0; gap < CONNECT; ++gap)
+        {
+            Bitboard open = ~Bitboard(0);
+            for(int i = 0; i < CONNECT; ++i)
+            {
+                int offset = (i - gap) * Shift;
+                if(offset > 0)
+                    open &= pieces >> offset;
+                else if(offset < 0)
+                    open &= pieces << -offset;
+            }
+            cells |= open;
+        }
 
-    // Check down-right direction
-    for(int r = row + 1, c = col + 1; r < ROWS && c < COLS && board[r][c] == player; ++r, ++c)
-        ++count;
+        return cells;
+    }
+}
 
-    return count >= 4;
+// Cells that would give the pieces a line of CONNECT, callers drop the filled ones
+template<int Rows, int Cols, int Connect>
+typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard BasicConnect4Game<Rows, Cols, Connect>::completingCells(Bitboard pieces)
+{
+    // Vertical lines only ever end in a gap on top
+    Bitboard vertical = runStarts<1, CONNECT - 1>(pieces) << (CONNECT - 1);
+    return (vertical | lineGaps<COL_BITS>(pieces) | lineGaps<COL_BITS + 1>(pieces) | lineGaps<COL_BITS - 1>(pieces)) &
+           boardMask();
 }
 
-// Check for 4 in a row in all directions
-bool Connect4Game::checkWinFromPosition(int row, int col, int player) const
+// Column of the lowest set bit
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::lowestCol(Bitboard cells)
 {
-    return checkHorizontal(row, col, player) ||
-           checkVertical(row, col, player) ||
-           checkDiagonalUp(row, col, player) ||
-           checkDiagonalDown(row, col, player);
+    int col = 0;
+    while(!(cells & columnMask(0)))
+    {
+        cells >>= COL_BITS;
+        ++col;
+    }
+
+    return col;
 }
 
 // Get rows (public data)
-int Connect4Game::getRows() const
-{ 
-    return ROWS; 
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getRows() const
+{
+    return ROWS;
 }
 
 // Get columns (public data)
-int Connect4Game::getCols() const
-{ 
-    return COLS; 
+template<int Rows, int Cols, int Connect>
+int BasicConnect4Game<Rows, Cols, Connect>::getCols() const
+{
+    return COLS;
 }
 
+
+
+//----------------------------------------------------------------------------------------//
+// Board sizes in use
+
+template class BasicConnect4Game<6, 7>;
+template class BasicConnect4Game<7, 8>;
+template class BasicConnect4Game<7, 9>;
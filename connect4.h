@@ -4,6 +4,11 @@
 #ifndef CONNECT4_H
 #define CONNECT4_H
 
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
 // GameColor (RGBA)
 struct GameColor 
 {
@@ -13,15 +18,23 @@ struct GameColor
         : r(red), g(green), b(blue), a(alpha) {}
 };
 
-// Connect4 Game
-class Connect4Game 
+/*
+Connect4 Game for a board of ROWS x COLS where CONNECT pieces in a line win.
+Every board size is its own type, so all masks and shift amounts are
+compile-time constants and each size gets its own specialized win checks.
+*/
+template<int Rows, int Cols, int Connect = 4>
+class BasicConnect4Game
 {
     public:
-        Connect4Game();
+        BasicConnect4Game();
 
         // Game logic
         bool dropPiece(int col);
+        bool undoMove();
+        bool playSequence(const std::string& moves);
         int checkWinner();
+        bool checkWinFromPosition(int row, int col, int player) const;
         bool isColumnFull(int col) const;
         bool isBoardFull() const;
         void resetGame();
@@ -31,34 +44,176 @@ class Connect4Game
         int getCurrentPlayer() const;
         bool isGameOver() const;
         int getWinner() const;
+        unsigned getVersion() const; // Changes every time the board changes
+        int getMove(int index) const; // Column of a move played so far, -1 if there is none
+
+        // (static) - a property of the game type and not a specific game
+        // Board size
+        static const int ROWS = Rows;
+        static const int COLS = Cols;
+        static const int CONNECT = Connect;
+        static const int COL_BITS = ROWS + 1; // Each column gets one spare bit on top
+
+        // One bit per cell, see the layout in connect4.cpp (boards over 64 bits use 128-bit masks)
+        using Bitboard = typename std::conditional<COL_BITS * COLS <= 64, uint64_t, unsigned __int128>::type;
+
+        // Bitboard access
+        Bitboard getPlayerPieces(int player) const;
+        static int findWinner(Bitboard pieces1, Bitboard pieces2); // Same result as checkWinner()
+
+        // Fast path for replaying many games on bare bitboards, with no undo, hash or history to keep up
+        static Bitboard dropCell(Bitboard occupied, int col);            // Cell a piece lands on, 0 if the column is full
+        static bool hasLine(Bitboard pieces);                            // CONNECT pieces in a row anywhere
+        static Bitboard threatCells(Bitboard pieces, Bitboard occupied); // Playable cells completing a line of pieces
+
+        // Search support
+        int getMoveCount() const;
+        bool isWinningMove(int col) const;
+        Bitboard getPositionKey() const; // Exact, no two positions share a key
+        Bitboard getMirroredKey() const; // Key of the position reflected left to right
+
+        // A position and its mirror image share one canonical key (the lower of the two),
+        // mirrored tells whether columns must be flipped with mirrorColumn() to match it
+        Bitboard getCanonicalKey() const;
+        Bitboard getCanonicalKey(bool& mirrored) const;
+        static int mirrorColumn(int col);
+        uint64_t getHash() const;        // Zobrist hash, kept up to date by every move
+
+        // Threat masks, built with shifts over the whole board instead of trying moves
+        Bitboard getWinningCells() const;         // Empty cells that complete a line for the current player
+        Bitboard getWinningCellsAfter(Bitboard cell) const; // The same once the current player has taken cell
+        Bitboard getOpponentWinningCells() const; // The same for the other player
+        Bitboard getPlayableCells() const;        // Where a piece dropped in each open column lands
+        bool canWinNext() const;                  // The current player has a winning move
+        Bitboard getNonLosingMoves() const;       // Playable cells that don't give the opponent a win,
+                                                  // only meaningful when canWinNext() is false
 
         // Constants for external access
         int getRows() const;
         int getCols() const;
 
-        // (static) - a property of the game type and not a specific game
         // Player constants (other code needs these values)
         static const int EMPTY = 0;
         static const int PLAYER1 = 1;
         static const int PLAYER2 = 2;
 
+        // Masks built at compile time
+        static constexpr Bitboard cellBit(int row, int col);
+        static constexpr Bitboard columnMask(int col);
+        static constexpr Bitboard bottomMask();
+        static constexpr Bitboard boardMask();
+
+        // Random key for each (player, cell bit), the hash is the XOR of the keys of every piece
+        static const int ZOBRIST_SIZE = 2 * COL_BITS * COLS;
+        static const std::array<uint64_t, ZOBRIST_SIZE> ZOBRIST_KEYS;
+
     private:
-        // Game specific constants
-        static const int ROWS = 6;
-        static const int COLS = 7;
+        // One entry per piece on the board, enough to undo it exactly
+        struct MoveRecord
+        {
+            int8_t col;
+            int8_t winner;   // State before the move
+            bool gameOver;
+        };
 
         // Data 
-        int board[ROWS][COLS];
+        Bitboard boards[2];  // Pieces of player 1 and player 2
+        Bitboard mirrorBoards[2]; // The same pieces reflected left to right
+        int heights[COLS];   // Number of pieces in each column
+        int moveCount;       // Total pieces on the board
         int currentPlayer;
         bool gameOver;
         int winner;
+        uint64_t hash;       // Zobrist hash of the pieces on the board
+        unsigned version;    // Bumped by every move, undo and reset
+        MoveRecord history[ROWS * COLS];
 
         // Helper methods
-        bool checkHorizontal(int row, int col, int player) const;
-        bool checkVertical(int row, int col, int player) const;
-        bool checkDiagonalUp(int row, int col, int player) const;
-        bool checkDiagonalDown(int row, int col, int player) const;
-        bool checkWinFromPosition(int row, int col, int player) const;
+        static constexpr std::array<uint64_t, ZOBRIST_SIZE> makeZobristKeys();
+        template<int Shift, int Length> static Bitboard runStarts(Bitboard pieces);
+        template<int Shift, int Length> static Bitboard spreadRuns(Bitboard starts);
+        static bool hasConnection(Bitboard pieces);
+        static Bitboard winningCells(Bitboard pieces);
+        template<int Shift> static Bitboard lineGaps(Bitboard pieces);
+        static Bitboard completingCells(Bitboard pieces);
+        static int lowestCol(Bitboard cells);
 };
 
+
+
+//----------------------------------------------------------------------------------------//
+// Compile-time masks
+
+// Bit for a board cell (row 0 is the top of the board)
+template<int Rows, int Cols, int Connect>
+constexpr typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard
+BasicConnect4Game<Rows, Cols, Connect>::cellBit(int row, int col)
+{
+    return Bitboard(1) << (col * COL_BITS + (ROWS - 1 - row));
+}
+
+// Every playable cell of one column
+template<int Rows, int Cols, int Connect>
+constexpr typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard
+BasicConnect4Game<Rows, Cols, Connect>::columnMask(int col)
+{
+    return ((Bitboard(1) << ROWS) - 1) << (col * COL_BITS);
+}
+
+// Lowest cell of every column
+template<int Rows, int Cols, int Connect>
+constexpr typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard
+BasicConnect4Game<Rows, Cols, Connect>::bottomMask()
+{
+    Bitboard bottom = 0;
+    for(int col = 0; col < COLS; ++col)
+        bottom |= Bitboard(1) << (col * COL_BITS);
+
+    return bottom;
+}
+
+// Every playable cell
+template<int Rows, int Cols, int Connect>
+constexpr typename BasicConnect4Game<Rows, Cols, Connect>::Bitboard
+BasicConnect4Game<Rows, Cols, Connect>::boardMask()
+{
+    return bottomMask() * ((Bitboard(1) << ROWS) - 1);
+}
+
+// Fixed pseudo-random keys (splitmix64), the same in every build so hashes can be stored
+template<int Rows, int Cols, int Connect>
+constexpr std::array<uint64_t, BasicConnect4Game<Rows, Cols, Connect>::ZOBRIST_SIZE>
+BasicConnect4Game<Rows, Cols, Connect>::makeZobristKeys()
+{
+    std::array<uint64_t, ZOBRIST_SIZE> keys = {};
+    uint64_t state = 0x436F6E6E65637434ULL ^ (uint64_t(ROWS) << 16 | uint64_t(COLS) << 8 | uint64_t(CONNECT));
+
+    for(uint64_t& key : keys)
+    {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        key = z ^ (z >> 31);
+    }
+
+    return keys;
+}
+
+template<int Rows, int Cols, int Connect>
+const std::array<uint64_t, BasicConnect4Game<Rows, Cols, Connect>::ZOBRIST_SIZE>
+BasicConnect4Game<Rows, Cols, Connect>::ZOBRIST_KEYS = makeZobristKeys();
+
+
+
+// Board sizes in use (columns x rows)
+using Connect4Game = BasicConnect4Game<6, 7>;
+using Connect4Game8x7 = BasicConnect4Game<7, 8>;
+using Connect4Game9x7 = BasicConnect4Game<7, 9>;
+
+// Compiled once in connect4.cpp
+extern template class BasicConnect4Game<6, 7>;
+extern template class BasicConnect4Game<7, 8>;
+extern template class BasicConnect4Game<7, 9>;
+
 #endif
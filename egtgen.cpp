@@ -0,0 +1,231 @@
+// Connect 4
+// Endgame table generator: solves every position with at most K empty cells
+// reachable from a set of seed positions and writes them as a table file
+//
+// Seeds are played out to the first ply of the table (ROWS * COLS - K), then
+// every position below that is enumerated and solved exactly. Enumerating the
+// whole board is out of reach for all but tiny K, so seeds pick the region.
+//
+// Options:
+//   -k N     empty cells at the first ply of the table (default 8)
+//   -i path  seed positions, one move string per line ("-" reads stdin)
+//   -r path  seed from the games of a record file
+//   -n N     seed from N random games (default 1000 if no other seeds are given)
+//   -s seed  random seed (default 1)
+//   -o path  output file (default connect4.egt)
+
+#include "book.h"
+#include "policy.h"
+#include "record.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+using std::cout, std::cerr, std::endl;
+
+// Exact result of one position, keyed by its canonical key
+struct EndgameEntry
+{
+    int8_t score;
+    int8_t bestMove; // In the canonical orientation
+};
+
+// Solves whole subtrees exactly, remembering every unfinished position it meets
+class EndgameSolver
+{
+    public:
+        // Score of the position for the player to move, the game must not be over
+        int solve(Connect4Game& game)
+        {
+            bool mirrored;
+            uint64_t key = game.getCanonicalKey(mirrored);
+            auto found = positions.find(key);
+            if(found != positions.end())
+                return found->second.score;
+
+            int cells = game.getRows() * game.getCols();
+            int moveCount = game.getMoveCount();
+            int best = -cells;
+            int bestMove = -1;
+
+            for(int i = 0; i < game.getCols(); ++i)
+            {
+                // Center first, so ties go to the move the solver would pick
+                int col = game.getCols() / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+                if(game.isColumnFull(col))
+                    continue;
+
+                int score;
+                if(game.isWinningMove(col))
+                    score = (cells + 1 - moveCount) / 2;
+                else
+                {
+                    game.dropPiece(col);
+                    score = game.isGameOver() ? 0 : -solve(game);
+                    game.undoMove();
+                }
+
+                if(score > best)
+                {
+                    best = score;
+                    bestMove = col;
+                }
+            }
+
+            int storedMove = mirrored ? Connect4Game::mirrorColumn(bestMove) : bestMove;
+            positions[key] = EndgameEntry{static_cast<int8_t>(best), static_cast<int8_t>(storedMove)};
+            return best;
+        }
+
+        std::vector<BookEntry> getEntries() const
+        {
+            std::vector<BookEntry> entries;
+            entries.reserve(positions.size());
+            for(const auto& position : positions)
+                entries.push_back(BookEntry{position.first, position.second.score, position.second.bestMove});
+            return entries;
+        }
+
+        size_t getPositionCount() const
+        {
+            return positions.size();
+        }
+
+    private:
+        std::unordered_map<uint64_t, EndgameEntry> positions;
+};
+
+int main(int argc, char* argv[])
+{
+    int empty = 8;
+    std::string seedPath;
+    std::string recordPath;
+    long randomSeeds = -1;
+    uint64_t seed = 1;
+    std::string path = "connect4.egt";
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            empty = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            seedPath = argv[++i];
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            randomSeeds = atol(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            path = argv[++i];
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-k empty] [-i seeds] [-r record] [-n random] [-s seed] [-o table]" << endl;
+            return 1;
+        }
+    }
+
+    Connect4Game board;
+    int cells = board.getRows() * board.getCols();
+    if(empty < 1 || empty > cells)
+    {
+        cerr << "-k must be between 1 and " << cells << endl;
+        return 1;
+    }
+    int firstPly = cells - empty;
+    if(randomSeeds < 0)
+        randomSeeds = (seedPath.empty() && recordPath.empty()) ? 1000 : 0;
+
+    EndgameSolver solver;
+    size_t seeds = 0;
+
+    // Seeds that end before the table starts have nothing to add
+    auto addSeed = [&](Connect4Game& game)
+    {
+        if(game.getMoveCount() != firstPly || game.isGameOver())
+            return;
+
+        solver.solve(game);
+        if(++seeds % 100 == 0)
+            cerr << seeds << " seeds, " << solver.getPositionCount() << " positions" << endl;
+    };
+
+    // Seed positions are extended with random moves up to the first ply
+    Random random(seed);
+    RandomPolicy policy;
+    auto extendSeed = [&](Connect4Game& game)
+    {
+        while(game.getMoveCount() < firstPly && !game.isGameOver())
+            game.dropPiece(policy.chooseMove(game, random));
+        addSeed(game);
+    };
+
+    if(!seedPath.empty())
+    {
+        std::ifstream file;
+        if(seedPath != "-")
+        {
+            file.open(seedPath);
+            if(!file)
+            {
+                cerr << "Could not open " << seedPath << endl;
+                return 1;
+            }
+        }
+        std::istream& input = (seedPath == "-") ? std::cin : file;
+
+        std::string line;
+        while(std::getline(input, line))
+        {
+            std::istringstream fields(line);
+            std::string moves;
+            fields >> moves;
+
+            Connect4Game game;
+            if(!game.playSequence(moves == "-" ? "" : moves) || game.getMoveCount() > firstPly)
+            {
+                cerr << "Invalid seed: " << line << endl;
+                continue;
+            }
+            extendSeed(game);
+        }
+    }
+
+    if(!recordPath.empty())
+    {
+        RecordReader reader;
+        if(!reader.open(recordPath) || reader.getRows() != board.getRows() || reader.getCols() != board.getCols())
+        {
+            cerr << "Could not read " << recordPath << endl;
+            return 1;
+        }
+
+        RecordCursor cursor = reader.cursor();
+        GameRecord record;
+        while(reader.next(cursor, record))
+        {
+            Connect4Game game;
+            if(record.length >= firstPly && record.replay(game, firstPly))
+                addSeed(game);
+        }
+    }
+
+    for(long i = 0; i < randomSeeds; ++i)
+    {
+        Connect4Game game;
+        extendSeed(game);
+    }
+
+    std::vector<BookEntry> entries = solver.getEntries();
+    if(!OpeningBook::write(path, board.getRows(), board.getCols(), cells, entries, firstPly))
+    {
+        cerr << "Could not write " << path << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << entries.size() << " positions from " << seeds << " seeds to " << path << endl;
+    return 0;
+}
@@ -0,0 +1,376 @@
+// Connect 4
+// Contains function implementations for the learned position evaluator
+
+#include "evaluator.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EVAL_X86 1
+#include <immintrin.h>
+#endif
+
+// Every board size shares the hidden size, so the kernels don't depend on the game
+static const int HIDDEN = EvaluatorNetwork<Connect4Game>::HIDDEN;
+static_assert(HIDDEN == 32, "The kernels are unrolled for 32 hidden values per player");
+
+
+
+// Portable kernels, for machines without SSE2
+//----------------------------------------------------------------------------------------//
+
+#ifndef EVAL_X86
+
+// to = from + row, for one player's accumulator
+static void addRowScalar(const int16_t* from, const int16_t* row, int16_t* to)
+{
+    for(int i = 0; i < HIDDEN; ++i)
+        to[i] = from[i] + row[i];
+}
+
+// Clamped accumulators (side to move first) dotted with the output weights
+static int32_t forwardScalar(const int16_t* us, const int16_t* them, const int8_t* weights)
+{
+    int32_t sum = 0;
+    for(int i = 0; i < HIDDEN; ++i)
+    {
+        sum += std::clamp<int>(us[i], 0, 127) * weights[i];
+        sum += std::clamp<int>(them[i], 0, 127) * weights[HIDDEN + i];
+    }
+
+    return sum;
+}
+
+#endif
+
+
+
+// x86 kernels
+//----------------------------------------------------------------------------------------//
+
+#ifdef EVAL_X86
+
+static void addRowSSE2(const int16_t* from, const int16_t* row, int16_t* to)
+{
+    for(int i = 0; i < HIDDEN; i += 8)
+    {
+        __m128i sum = _mm_add_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(from + i)),
+                                    _mm_load_si128(reinterpret_cast<const __m128i*>(row + i)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(to + i), sum);
+    }
+}
+
+// SSE2 has no unsigned x signed byte multiply, so the weights are widened to int16
+static int32_t forwardSSE2(const int16_t* us, const int16_t* them, const int8_t* weights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16(127);
+    const int16_t* halves[2] = {us, them};
+    __m128i sum = zero;
+
+    for(int half = 0; half < 2; ++half)
+    {
+        for(int i = 0; i < HIDDEN; i += 8)
+        {
+            __m128i hidden = _mm_load_si128(reinterpret_cast<const __m128i*>(halves[half] + i));
+            hidden = _mm_min_epi16(_mm_max_epi16(hidden, zero), limit);
+
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + half * HIDDEN + i));
+            __m128i wide = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8); // Sign extend
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(hidden, wide));
+        }
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// 32 clamped int16 values packed to bytes in their original order
+__attribute__((target("avx2"))) static inline __m256i clampPack256(const int16_t* values)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i limit = _mm256_set1_epi16(127);
+    __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i*>(values));
+    __m256i high = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + 16));
+    low = _mm256_min_epi16(_mm256_max_epi16(low, zero), limit);
+    high = _mm256_min_epi16(_mm256_max_epi16(high, zero), limit);
+
+    // Packing works within each 128-bit lane, put the 64-bit quarters back in order
+    return _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+}
+
+// Byte products summed in pairs can't saturate: 2 * 127 * 127 fits in int16
+__attribute__((target("avx2"))) static int32_t forwardAVX2(const int16_t* us, const int16_t* them, const int8_t* weights)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i ourWeights = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights));
+    __m256i theirWeights = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + HIDDEN));
+
+    __m256i products = _mm256_maddubs_epi16(clampPack256(us), ourWeights);
+    __m256i sum = _mm256_madd_epi16(products, ones);
+    products = _mm256_maddubs_epi16(clampPack256(them), theirWeights);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+
+#endif
+
+using AddRowKernel = void (*)(const int16_t*, const int16_t*, int16_t*);
+using ForwardKernel = int32_t (*)(const int16_t*, const int16_t*, const int8_t*);
+
+// The best kernels this CPU supports, picked once
+static AddRowKernel addRowKernel()
+{
+#ifdef EVAL_X86
+    return addRowSSE2;
+#else
+    return addRowScalar;
+#endif
+}
+
+static ForwardKernel forwardKernel()
+{
+#ifdef EVAL_X86
+    static const ForwardKernel best = __builtin_cpu_supports("avx2") ? forwardAVX2 : forwardSSE2;
+    return best;
+#else
+    return forwardScalar;
+#endif
+}
+
+
+
+// Weights
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+BasicEvaluator<Game>::BasicEvaluator(): top(0)
+{
+    memset(&network, 0, sizeof(network));
+    memset(&stack[0], 0, sizeof(stack[0]));
+}
+
+// Loads weights saved for the same board size, the old weights stay on failure
+template<typename Game>
+bool BasicEvaluator<Game>::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    FileHeader fileHeader;
+    if(!file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)))
+        return false;
+
+    if(memcmp(fileHeader.magic, "C4NN", 4) != 0 || fileHeader.version != VERSION ||
+       fileHeader.rows != static_cast<uint32_t>(Game::ROWS) || fileHeader.cols != static_cast<uint32_t>(Game::COLS) ||
+       fileHeader.hidden != static_cast<uint32_t>(Network::HIDDEN))
+        return false;
+
+    Network loaded;
+    if(!file.read(reinterpret_cast<char*>(&loaded), sizeof(loaded)))
+        return false;
+
+    setNetwork(loaded);
+    return true;
+}
+
+template<typename Game>
+bool BasicEvaluator<Game>::save(const std::string& path) const
+{
+    FileHeader fileHeader = {};
+    memcpy(fileHeader.magic, "C4NN", 4);
+    fileHeader.version = VERSION;
+    fileHeader.rows = Game::ROWS;
+    fileHeader.cols = Game::COLS;
+    fileHeader.hidden = Network::HIDDEN;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    file.write(reinterpret_cast<const char*>(&network), sizeof(network));
+
+    return static_cast<bool>(file);
+}
+
+// New weights make the features out of date, call reset() before evaluating incrementally
+template<typename Game>
+void BasicEvaluator<Game>::setNetwork(const Network& weights)
+{
+    network = weights;
+    top = 0;
+}
+
+template<typename Game>
+const typename BasicEvaluator<Game>::Network& BasicEvaluator<Game>::getNetwork() const
+{
+    return network;
+}
+
+
+
+// Incremental evaluation
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+void BasicEvaluator<Game>::reset(const Game& game)
+{
+    top = 0;
+    refresh(game, stack[0]);
+}
+
+template<typename Game>
+bool BasicEvaluator<Game>::dropPiece(Game& game, int col)
+{
+    int cell = (col >= 0 && col < Game::COLS) ? landingCell(game, col) : -1;
+    int player = game.getCurrentPlayer();
+    if(cell < 0 || top >= Network::CELLS || !game.dropPiece(col))
+        return false;
+
+    addPiece(stack[top], stack[top + 1], player, cell);
+    ++top;
+    return true;
+}
+
+// Undoing past the position of the last reset() rebuilds the features from the board
+template<typename Game>
+bool BasicEvaluator<Game>::undoMove(Game& game)
+{
+    if(!game.undoMove())
+        return false;
+
+    if(top > 0)
+        --top;
+    else
+        refresh(game, stack[0]);
+    return true;
+}
+
+template<typename Game>
+int BasicEvaluator<Game>::evaluate(const Game& game) const
+{
+    return forward(stack[top], game.getCurrentPlayer());
+}
+
+// Each child is one row added to the current accumulators, no move is played
+template<typename Game>
+void BasicEvaluator<Game>::evaluateChildren(const Game& game, int* scores) const
+{
+    int player = game.getCurrentPlayer();
+    int opponent = (player == Game::PLAYER1) ? Game::PLAYER2 : Game::PLAYER1;
+    Accumulator child;
+
+    for(int col = 0; col < Game::COLS; ++col)
+    {
+        int cell = landingCell(game, col);
+        if(cell < 0)
+        {
+            scores[col] = 0;
+            continue;
+        }
+
+        addPiece(stack[top], child, player, cell);
+        scores[col] = -forward(child, opponent);
+    }
+}
+
+
+
+// Evaluation from scratch
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+int BasicEvaluator<Game>::evaluatePosition(const Game& game) const
+{
+    Accumulator accumulator;
+    refresh(game, accumulator);
+    return forward(accumulator, game.getCurrentPlayer());
+}
+
+template<typename Game>
+void BasicEvaluator<Game>::evaluateBatch(const Game* games, size_t count, int* scores) const
+{
+    Accumulator accumulator;
+    for(size_t i = 0; i < count; ++i)
+    {
+        refresh(games[i], accumulator);
+        scores[i] = forward(accumulator, games[i].getCurrentPlayer());
+    }
+}
+
+
+
+//----------------------------------------------------------------------------------------//
+// Helper methods
+
+// Both accumulators from the bias and every piece on the board
+template<typename Game>
+void BasicEvaluator<Game>::refresh(const Game& game, Accumulator& accumulator) const
+{
+    AddRowKernel addRow = addRowKernel();
+    for(int side = 0; side < 2; ++side)
+    {
+        int16_t* values = accumulator.values[side];
+        memcpy(values, network.hiddenBias, sizeof(network.hiddenBias));
+
+        for(int owner = 0; owner < 2; ++owner)
+        {
+            typename Game::Bitboard pieces = game.getPlayerPieces(owner + 1);
+            int offset = (owner == side) ? 0 : Network::CELLS;
+
+            for(int col = 0; col < Game::COLS; ++col)
+            {
+                // A column fits in the low bits once shifted down
+                uint64_t column = static_cast<uint64_t>((pieces >> (col * Game::COL_BITS)) & ((1u << Game::ROWS) - 1));
+                while(column)
+                {
+                    int cell = col * Game::ROWS + __builtin_ctzll(column);
+                    addRow(values, network.inputWeights[offset + cell], values);
+                    column &= column - 1;
+                }
+            }
+        }
+    }
+}
+
+// to = from with a piece of player (1 or 2) added on cell
+template<typename Game>
+void BasicEvaluator<Game>::addPiece(const Accumulator& from, Accumulator& to, int player, int cell) const
+{
+    AddRowKernel addRow = addRowKernel();
+    int mine = player - 1;
+    addRow(from.values[mine], network.inputWeights[cell], to.values[mine]);
+    addRow(from.values[1 - mine], network.inputWeights[Network::CELLS + cell], to.values[1 - mine]);
+}
+
+template<typename Game>
+int BasicEvaluator<Game>::forward(const Accumulator& accumulator, int player) const
+{
+    int mine = player - 1;
+    int64_t raw = forwardKernel()(accumulator.values[mine], accumulator.values[1 - mine], network.outputWeights);
+    raw += network.outputBias;
+
+    int score = static_cast<int>(raw * SCORE_SCALE / (127 * 64));
+    return std::clamp(score, -MAX_SCORE, MAX_SCORE);
+}
+
+// Feature cell a piece dropped in col lands on, -1 if the column is full
+template<typename Game>
+int BasicEvaluator<Game>::landingCell(const Game& game, int col)
+{
+    typename Game::Bitboard cell = game.getPlayableCells() & Game::columnMask(col);
+    if(!cell)
+        return -1;
+
+    return col * Game::ROWS + __builtin_ctzll(static_cast<uint64_t>(cell >> (col * Game::COL_BITS)));
+}
+
+
+
+//----------------------------------------------------------------------------------------//
+// Board sizes in use
+
+template class BasicEvaluator<Connect4Game>;
+template class BasicEvaluator<Connect4Game8x7>;
@@ -0,0 +1,111 @@
+// Connect 4
+// Learned position evaluator header file
+
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include "connect4.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+The evaluator is a small NNUE-style network. Its inputs are one feature per
+(owner, cell), seen from each player in turn: "my piece here" and "their
+piece here". The first layer is kept as an accumulator per player, the sum
+of the weight rows of every piece on the board, so a move adds one row to
+each accumulator and an undo pops back to the copy below it on a stack.
+
+An evaluation clamps the accumulators to 0..127 (side to move first), packs
+them to int8 and takes a dot product with the int8 output weights:
+  score = (sum(hidden * output) + outputBias) * SCORE_SCALE / (127 * 64)
+which is SCORE_SCALE times the log odds of the side to move winning. On x86
+the packing and dot product run on AVX2 (or SSE2), picked at runtime, and
+nothing is allocated once the evaluator exists.
+
+Weights file layout (native byte order):
+  header   "C4NN", version, rows, cols, hidden size
+  weights  the EvaluatorNetwork struct exactly as it is laid out in RAM
+*/
+
+// Quantized weights for one board size
+template<typename Game>
+struct EvaluatorNetwork
+{
+    static const int CELLS = Game::ROWS * Game::COLS;
+    static const int INPUTS = 2 * CELLS; // Cell index col * ROWS + height, their pieces after mine
+    static const int HIDDEN = 32;        // Per player, two SIMD registers of int16
+
+    alignas(64) int16_t inputWeights[INPUTS][HIDDEN]; // Scaled by 127
+    alignas(64) int16_t hiddenBias[HIDDEN];
+    alignas(64) int8_t outputWeights[2 * HIDDEN];      // Scaled by 64, side to move first
+    int32_t outputBias;                                // Scaled by 127 * 64
+};
+
+// Evaluates positions of one board size, incrementally or from scratch
+template<typename Game>
+class BasicEvaluator
+{
+    public:
+        using Network = EvaluatorNetwork<Game>;
+
+        static const int SCORE_SCALE = 100;   // Score units per unit of log odds
+        static const int MAX_SCORE = 999;     // Scores are clamped below the search's win scores
+
+        BasicEvaluator(); // All weights zero until load() or setNetwork()
+
+        // Weights
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+        void setNetwork(const Network& weights);
+        const Network& getNetwork() const;
+
+        // Incremental use: play and undo moves through the evaluator so the features follow the board
+        void reset(const Game& game);       // Rebuild the features from the board
+        bool dropPiece(Game& game, int col);
+        bool undoMove(Game& game);
+        int evaluate(const Game& game) const; // For the side to move, game must be the one last reset or played
+
+        // Scores for the player who moved of every legal child of the current position (0 for full columns)
+        void evaluateChildren(const Game& game, int* scores) const;
+
+        // From scratch, one score per position for its side to move
+        int evaluatePosition(const Game& game) const;
+        void evaluateBatch(const Game* games, size_t count, int* scores) const;
+
+    private:
+        struct Accumulator
+        {
+            alignas(32) int16_t values[2][Network::HIDDEN]; // Seen from player 1 and player 2
+        };
+
+        struct FileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t rows, cols;
+            uint32_t hidden;
+        };
+
+        static const uint32_t VERSION = 1;
+
+        Network network;
+        Accumulator stack[Network::CELLS + 1]; // One per move played through the evaluator
+        int top;
+
+        // Helper methods
+        void refresh(const Game& game, Accumulator& accumulator) const;
+        void addPiece(const Accumulator& from, Accumulator& to, int player, int cell) const;
+        int forward(const Accumulator& accumulator, int player) const;
+        static int landingCell(const Game& game, int col);
+};
+
+// The board sizes train can fit weights for and SearchPolicy can play, records hold 8 columns at most
+using Evaluator = BasicEvaluator<Connect4Game>;
+using Evaluator8x7 = BasicEvaluator<Connect4Game8x7>;
+
+// Compiled once in evaluator.cpp
+extern template class BasicEvaluator<Connect4Game>;
+extern template class BasicEvaluator<Connect4Game8x7>;
+
+#endif
@@ -1,13 +1,33 @@
 // Connect 4
 // This is the main function for the Connect 4 game
 
+#include "ai.h"
+#include "record.h"
 #include "ui.h"
+#include <cstring>
 #include <iostream>
+#include <memory>
 
 using std::cout, std::endl;
 
-int main()
+// Run with a record file (connect4 games.c4r) to watch its games played back,
+// --perf path rewrites a JSON snapshot of the performance counters every second,
+// --weights path has the computer score positions with trained evaluator weights
+int main(int argc, char* argv[])
 {
+    const char* recordPath = nullptr;
+    const char* weightsPath = "";
+    std::unique_ptr<PerfReporter> perfReporter;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--perf") == 0 && i + 1 < argc)
+            perfReporter.reset(new PerfReporter(argv[++i]));
+        else if(strcmp(argv[i], "--weights") == 0 && i + 1 < argc)
+            weightsPath = argv[++i];
+        else
+            recordPath = argv[i];
+    }
+
     // Initialize raylib window
     const int screenWidth = 900;
     const int screenHeight = 700;
@@ -17,59 +37,130 @@ int main()
     // Create game objects
     Connect4Game game;
     Connect4UI ui(150, 150, 70); // x = 150, y = 150, cellSize = 70
+    AIPlayer ai(AIPlayer::DEFAULT_MOVE_TIME, weightsPath); // Plays player 2 when enabled
 
     // Game state variables
     bool gameRunning = true;
     int hoveredColumn = -1; // Default invalid column chosen
+    bool aiEnabled = false;
+    bool showPerf = false;
+
+    // Record playback
+    const double PLAYBACK_DELAY = 0.5; // Seconds between moves
+    RecordReader reader;
+    RecordCursor cursor = {};
+    GameRecord record = {};
+    int playbackMove = 0;
+    double nextMoveTime = 0;
+    if(recordPath)
+    {
+        if(reader.open(recordPath) && reader.getRows() == Connect4Game::ROWS && reader.getCols() == Connect4Game::COLS)
+        {
+            cursor = reader.cursor();
+            if(!reader.next(cursor, record))
+                reader.close();
+        }
+        else
+        {
+            reader.close();
+            cout << "Can't play back " << recordPath << endl;
+        }
+    }
 
     // Main game loop
     while(!WindowShouldClose() && gameRunning)
     {
         // INPUT HANDLING
+        PERF_BEGIN(Input);
         Vector2 mousePos = GetMousePosition(); // Vector2: float x, y;
 
         // Get column mouse is hovering over
         hoveredColumn = ui.getColumnFromMouseX(mousePos.x);
 
-        // Handle mouse clicks
-        if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+        // The computer's turn, it thinks on its own thread so the frame loop never waits
+        bool playback = reader.isOpen();
+        bool aiTurn = !playback && aiEnabled && !game.isGameOver() && game.getCurrentPlayer() == Connect4Game::PLAYER2;
+        int chosenColumn = -1;
+        if(playback)
         {
-            // Hovered column is valid and game is running
-            if(hoveredColumn != -1 && !game.isGameOver())
+            // N skips to the next game, a finished game moves on by itself after a pause
+            if(IsKeyPressed(KEY_N) || (playbackMove >= record.length && GetTime() >= nextMoveTime))
             {
-                // Attempt to drop piece in clicked column
-                bool success = game.dropPiece(hoveredColumn);
-                if(success)
+                game.resetGame();
+                playbackMove = 0;
+                nextMoveTime = GetTime() + PLAYBACK_DELAY;
+                if(!reader.next(cursor, record))
                 {
-                    cout << "Player " << (game.getCurrentPlayer() == 1 ? 2 : 1)
-                         << " dropped piece in column " << hoveredColumn << endl;
-
-                    // Update game state by checking for winner/tie
-                    game.checkWinner();
-
-                    // Check if game is over after the move
-                    if(game.isGameOver())
-                    {
-                        if(game.getWinner() != 0)
-                            cout << "Game Over! Player " << game.getWinner() << " wins!" << endl;
-                        else
-                            cout << "Game Over! It's a tie!" << endl;
-                    }
+                    reader.close();
+                    cout << "Playback finished" << endl;
                 }
-                else // !success
-                    cout << "Column " << hoveredColumn << " is full!" << endl;
+            }
+            else if(playbackMove < record.length && GetTime() >= nextMoveTime)
+            {
+                chosenColumn = record.getMove(playbackMove++);
+                nextMoveTime = GetTime() + PLAYBACK_DELAY * (playbackMove < record.length ? 1 : 4);
             }
         }
+        else if(aiTurn)
+        {
+            int aiColumn;
+            if(ai.takeMove(aiColumn))
+                chosenColumn = aiColumn;
+            else if(!ai.isThinking())
+                ai.startSearch(game);
+        }
+        else if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) // Handle mouse clicks
+            chosenColumn = hoveredColumn;
+
+        // Chosen column is valid and game is running
+        if(chosenColumn != -1 && !game.isGameOver())
+        {
+            // Attempt to drop piece in chosen column
+            bool success = game.dropPiece(chosenColumn);
+            if(success)
+            {
+                cout << "Player " << (game.getCurrentPlayer() == 1 ? 2 : 1)
+                     << " dropped piece in column " << chosenColumn << endl;
+
+                // Update game state by checking for winner/tie
+                game.checkWinner();
+
+                // Check if game is over after the move
+                if(game.isGameOver())
+                {
+                    if(game.getWinner() != 0)
+                        cout << "Game Over! Player " << game.getWinner() << " wins!" << endl;
+                    else
+                        cout << "Game Over! It's a tie!" << endl;
+                }
+            }
+            else // !success
+                cout << "Column " << chosenColumn << " is full!" << endl;
+        }
 
         // Handle keyboard input
         if(IsKeyPressed(KEY_R)) // R - reset game
         {
+            ai.cancel();
             game.resetGame();
+            playbackMove = 0; // Start the recorded game over
             cout << "Game reset!" << endl;
         }
 
+        if(IsKeyPressed(KEY_A)) // A - computer plays player 2
+        {
+            aiEnabled = !aiEnabled;
+            if(!aiEnabled)
+                ai.cancel();
+            cout << "Computer player " << (aiEnabled ? "on" : "off") << endl;
+        }
+
+        if(IsKeyPressed(KEY_F3)) // F3 - performance overlay
+            showPerf = !showPerf;
+
         if(IsKeyPressed(KEY_ESCAPE)) // ESC - quit game
             gameRunning = false;
+        PERF_END(Input);
 
         // RENDERING
         BeginDrawing(); // Tells raylib to start a new frame
@@ -84,6 +175,12 @@ int main()
         DrawText("Click to drop piece", 10, 50, 20, DARKGRAY);
         DrawText("Press R to reset", 10, 75, 20, DARKGRAY);
         DrawText("Press ESC to quit", 10, 100, 20, DARKGRAY);
+        if(reader.isOpen())
+            DrawText("Playing back, press N for the next game", 520, 50, 20, DARKGRAY);
+        else
+            DrawText(aiEnabled ? "Press A to play a friend" : "Press A to play the computer", 520, 50, 20, DARKGRAY);
+        if(ai.isThinking())
+            DrawText(TextFormat("Computer thinking... depth %d", ai.getDepth()), 520, 75, 20, DARKGRAY);
 
         // Draw game status (Player turn / Win / Tie)
         ui.drawGameStatus(game);
@@ -92,7 +189,7 @@ int main()
         ui.drawBoard(game);
 
         // Draw column hover effect
-        if(hoveredColumn != -1 && !game.isGameOver() && ui.isMouseOverBoard(mousePos.x, mousePos.y))
+        if(hoveredColumn != -1 && !game.isGameOver() && !aiTurn && !playback && ui.isMouseOverBoard(mousePos.x, mousePos.y))
         {
             float columnX = ui.getBoardX() + (hoveredColumn * ui.getCellSize());
             Color hoverColor;
@@ -102,11 +199,16 @@ int main()
                 hoverColor = YELLOW; // YELLOW - Player 2
 
             // Draw rounded rectangle with correct hover color for player
-            Rectangle hoverRect = {columnX, ui.getBoardY() - 20, 70, 20};
+            Rectangle hoverRect = {columnX, ui.getBoardY() - 20, ui.getCellSize(), 20};
             DrawRectangleRounded(hoverRect, 0.3f, 0, hoverColor);
         }
 
+        if(showPerf)
+            ui.drawPerfOverlay(650, 150);
+
+        PERF_BEGIN(EndDrawing);
         EndDrawing(); // Tells raylib "frame is complete, show it on screen"
+        PERF_END(EndDrawing);
     }
 
     // Cleanup
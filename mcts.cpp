@@ -0,0 +1,481 @@
+// Connect 4
+// Contains function implementations for the Monte Carlo tree search player
+
+#include "mcts.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include <vector>
+
+double MCTSStats::getPlayoutsPerSecond() const
+{
+    return seconds > 0 ? playouts / seconds : 0.0;
+}
+
+
+
+// MCTSArena
+//----------------------------------------------------------------------------------------//
+
+MCTSArena::MCTSArena(uint32_t capacity): nodes(new MCTSNode[capacity]), capacity(capacity), used(0)
+{
+}
+
+uint32_t MCTSArena::allocate(uint32_t count)
+{
+    uint32_t first = used.fetch_add(count);
+    if(first > capacity - count || count > capacity)
+    {
+        // Leave the index past the end so later requests fail too
+        used.store(capacity);
+        return NONE;
+    }
+
+    return first;
+}
+
+void MCTSArena::clear()
+{
+    used.store(0);
+}
+
+MCTSNode& MCTSArena::operator[](uint32_t index)
+{
+    return nodes[index];
+}
+
+const MCTSNode& MCTSArena::operator[](uint32_t index) const
+{
+    return nodes[index];
+}
+
+uint32_t MCTSArena::getUsed() const
+{
+    uint32_t n = used.load();
+    return n < capacity ? n : capacity;
+}
+
+uint32_t MCTSArena::getCapacity() const
+{
+    return capacity;
+}
+
+
+
+// Search
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+BasicMCTSPlayer<Game>::BasicMCTSPlayer(int threads, uint32_t capacity, uint64_t seed):
+    arenas{MCTSArena(capacity), MCTSArena(capacity)},
+    active(0),
+    exploration(1.4),
+    seed(seed),
+    stats()
+{
+    setThreadCount(threads);
+    reset(Game());
+}
+
+// Best move for the game, found by playouts on every thread
+template<typename Game>
+int BasicMCTSPlayer<Game>::search(const Game& game, int moveTimeMs, unsigned long long maxPlayouts)
+{
+    auto start = std::chrono::steady_clock::now();
+    if(game.isGameOver())
+        return -1;
+
+    // Keep the tree if the game has only moved on from the last root
+    int rootMoves = rootGame.getMoveCount();
+    bool continues = game.getMoveCount() >= rootMoves;
+    for(int i = 0; i < rootMoves && continues; ++i)
+        continues = game.getMove(i) == rootGame.getMove(i);
+
+    if(continues)
+    {
+        for(int i = rootMoves; i < game.getMoveCount(); ++i)
+            advance(game.getMove(i));
+    }
+    else
+        reset(game);
+
+    if(tree().getUsed() > tree().getCapacity() / 2)
+        compact();
+
+    MCTSArena& nodes = tree();
+    MCTSNode& rootNode = nodes[root];
+    if(rootNode.state.load() != MCTSNode::EXPANDED && !expand(rootNode, rootGame))
+    {
+        // No room even after compacting, start over
+        reset(rootGame);
+        expand(tree()[root], rootGame);
+    }
+
+    stats.reusedVisits = tree()[root].visits.load();
+
+    if(moveTimeMs > 0 || maxPlayouts > 0)
+    {
+        auto deadline = moveTimeMs > 0 ? start + std::chrono::milliseconds(moveTimeMs)
+                                       : std::chrono::steady_clock::time_point::max();
+        std::atomic<unsigned long long> playouts(0);
+
+        // The calling thread is one of the workers
+        std::vector<Random> randoms;
+        for(int i = 0; i < threadCount; ++i)
+            randoms.emplace_back(seed++);
+
+        std::vector<std::thread> workers;
+        for(int i = 1; i < threadCount; ++i)
+            workers.emplace_back(&BasicMCTSPlayer::runWorker, this, std::ref(randoms[i]), std::ref(playouts),
+                                 maxPlayouts, deadline);
+        runWorker(randoms[0], playouts, maxPlayouts, deadline);
+        for(std::thread& worker : workers)
+            worker.join();
+
+        stats.playouts = maxPlayouts > 0 && playouts.load() > maxPlayouts ? maxPlayouts : playouts.load();
+    }
+    else
+        stats.playouts = 0;
+
+    // The most visited move is the most trusted one
+    const MCTSNode& searched = tree()[root];
+    int bestMove = -1;
+    uint32_t bestVisits = 0;
+    for(uint32_t i = 0; i < searched.childCount; ++i)
+    {
+        const MCTSNode& child = tree()[searched.firstChild + i];
+        if(bestMove == -1 || child.visits.load() > bestVisits)
+        {
+            bestMove = child.move;
+            bestVisits = child.visits.load();
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.seconds = elapsed.count();
+    stats.treeNodes = tree().getUsed();
+    stats.bytesPerNode = sizeof(MCTSNode);
+    stats.arenaBytes = 2 * sizeof(MCTSNode) * static_cast<size_t>(tree().getCapacity());
+
+    return bestMove;
+}
+
+// Follow a real move, the subtree below it is kept as it is
+template<typename Game>
+void BasicMCTSPlayer<Game>::advance(int col)
+{
+    const MCTSNode& node = tree()[root];
+    uint32_t next = MCTSArena::NONE;
+    if(node.state.load() == MCTSNode::EXPANDED)
+    {
+        for(uint32_t i = 0; i < node.childCount; ++i)
+        {
+            if(tree()[node.firstChild + i].move == col)
+                next = node.firstChild + i;
+        }
+    }
+
+    rootGame.dropPiece(col);
+    root = (next != MCTSArena::NONE) ? next : newRoot();
+}
+
+// Drop the whole tree and search from this position
+template<typename Game>
+void BasicMCTSPlayer<Game>::reset(const Game& game)
+{
+    tree().clear();
+    rootGame = game;
+    root = newRoot();
+}
+
+
+
+// Setters
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+void BasicMCTSPlayer<Game>::setThreadCount(int threads)
+{
+    threadCount = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+template<typename Game>
+void BasicMCTSPlayer<Game>::setExploration(double c)
+{
+    exploration = c;
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+const MCTSStats& BasicMCTSPlayer<Game>::getStats() const
+{
+    return stats;
+}
+
+template<typename Game>
+int BasicMCTSPlayer<Game>::getThreadCount() const
+{
+    return threadCount;
+}
+
+
+
+// Private Helper Methods
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+MCTSArena& BasicMCTSPlayer<Game>::tree()
+{
+    return arenas[active];
+}
+
+// Fresh unvisited node for the root position, starting over if the arena is full
+template<typename Game>
+uint32_t BasicMCTSPlayer<Game>::newRoot()
+{
+    uint32_t index = tree().allocate(1);
+    if(index == MCTSArena::NONE)
+    {
+        tree().clear();
+        index = tree().allocate(1);
+    }
+
+    MCTSNode& node = tree()[index];
+    node.visits.store(0);
+    node.score.store(0);
+    node.firstChild = 0;
+    node.state.store(MCTSNode::LEAF);
+    node.move = rootGame.getMoveCount() ? rootGame.getMove(rootGame.getMoveCount() - 1) : -1;
+    node.childCount = 0;
+    node.result = 0;
+    return index;
+}
+
+// Copy the tree below the root into the other arena and release the old one,
+// children stay side by side so the copy is a breadth-first walk
+template<typename Game>
+void BasicMCTSPlayer<Game>::compact()
+{
+    MCTSArena& from = tree();
+    MCTSArena& to = arenas[1 - active];
+    to.clear();
+
+    auto copyNode = [](const MCTSNode& source, MCTSNode& target)
+    {
+        target.visits.store(source.visits.load());
+        target.score.store(source.score.load());
+        target.firstChild = 0;
+        target.state.store(MCTSNode::LEAF);
+        target.move = source.move;
+        target.childCount = 0;
+        target.result = source.result;
+    };
+
+    uint32_t newRootIndex = to.allocate(1);
+    copyNode(from[root], to[newRootIndex]);
+
+    std::vector<std::pair<uint32_t, uint32_t>> pending = {{root, newRootIndex}};
+    for(size_t i = 0; i < pending.size(); ++i)
+    {
+        const MCTSNode& source = from[pending[i].first];
+        if(source.state.load() != MCTSNode::EXPANDED)
+            continue;
+
+        uint32_t block = to.allocate(source.childCount);
+        if(block == MCTSArena::NONE)
+            continue;
+
+        MCTSNode& target = to[pending[i].second];
+        for(uint32_t c = 0; c < source.childCount; ++c)
+        {
+            copyNode(from[source.firstChild + c], to[block + c]);
+            pending.emplace_back(source.firstChild + c, block + c);
+        }
+        target.firstChild = block;
+        target.childCount = source.childCount;
+        target.state.store(MCTSNode::EXPANDED);
+    }
+
+    from.clear();
+    active = 1 - active;
+    root = newRootIndex;
+}
+
+// Play out until the deadline passes or the shared playout budget is used up
+template<typename Game>
+void BasicMCTSPlayer<Game>::runWorker(Random& random, std::atomic<unsigned long long>& playouts,
+                                      unsigned long long maxPlayouts, std::chrono::steady_clock::time_point deadline)
+{
+    for(unsigned long long n = 0; ; ++n)
+    {
+        if(n % 64 == 0 && std::chrono::steady_clock::now() >= deadline)
+            break;
+        if(playouts.fetch_add(1) >= maxPlayouts && maxPlayouts > 0)
+            break;
+
+        runPlayout(random);
+    }
+}
+
+// One selection, expansion, playout and backup pass
+template<typename Game>
+void BasicMCTSPlayer<Game>::runPlayout(Random& random)
+{
+    MCTSArena& nodes = tree();
+    Game game = rootGame;
+    uint32_t path[Game::ROWS * Game::COLS + 1];
+    int length = 0;
+
+    // Visits are added on the way down, an unfinished playout counts as a loss (virtual loss)
+    uint32_t index = root;
+    nodes[index].visits.fetch_add(1);
+    path[length++] = index;
+
+    int winner;
+    while(true)
+    {
+        MCTSNode& node = nodes[index];
+        if(node.result != 0)
+        {
+            winner = node.result;
+            break;
+        }
+
+        // Leaves grow children on their second visit, until then they only play out
+        if(node.state.load(std::memory_order_acquire) != MCTSNode::EXPANDED &&
+           (node.visits.load() < 2 || !expand(node, game)))
+        {
+            winner = playout(game, random);
+            break;
+        }
+
+        index = selectChild(node);
+        game.dropPiece(nodes[index].move);
+        nodes[index].visits.fetch_add(1);
+        path[length++] = index;
+    }
+
+    // Each node scores for the player who moved into it, the root's mover is the root player's opponent
+    int rootPlayer = rootGame.getCurrentPlayer();
+    for(int i = 0; i < length; ++i)
+    {
+        int mover = (i % 2) ? rootPlayer : 3 - rootPlayer;
+        uint32_t points = (winner == mover) ? 2 : (winner == -1) ? 1 : 0;
+        if(points)
+            nodes[path[i]].score.fetch_add(points);
+    }
+}
+
+// UCB1 choice among the children, unvisited ones first
+template<typename Game>
+uint32_t BasicMCTSPlayer<Game>::selectChild(const MCTSNode& node) const
+{
+    const MCTSArena& nodes = arenas[active];
+    double logVisits = std::log(static_cast<double>(node.visits.load()) + 1.0);
+    uint32_t best = node.firstChild;
+    double bestValue = -1.0;
+
+    for(uint32_t i = node.firstChild; i < node.firstChild + node.childCount; ++i)
+    {
+        uint32_t visits = nodes[i].visits.load(std::memory_order_relaxed);
+        if(visits == 0)
+            return i;
+
+        double value = nodes[i].score.load(std::memory_order_relaxed) / (2.0 * visits) +
+                       exploration * std::sqrt(logVisits / visits);
+        if(value > bestValue)
+        {
+            bestValue = value;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+// Give the node one child per legal move, false if another thread got there first or the arena is full
+template<typename Game>
+bool BasicMCTSPlayer<Game>::expand(MCTSNode& node, const Game& game)
+{
+    uint8_t expected = MCTSNode::LEAF;
+    if(!node.state.compare_exchange_strong(expected, MCTSNode::EXPANDING))
+        return false;
+
+    int cols = game.getCols();
+    int count = 0;
+    for(int col = 0; col < cols; ++col)
+        count += !game.isColumnFull(col);
+
+    uint32_t block = tree().allocate(count);
+    if(block == MCTSArena::NONE)
+    {
+        node.state.store(MCTSNode::LEAF);
+        return false;
+    }
+
+    // Center first, so ties between unvisited moves favor the center
+    bool fills = game.getMoveCount() + 1 == game.getRows() * cols;
+    uint32_t next = block;
+    for(int i = 0; i < cols; ++i)
+    {
+        int col = cols / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+        if(game.isColumnFull(col))
+            continue;
+
+        MCTSNode& child = tree()[next++];
+        child.visits.store(0, std::memory_order_relaxed);
+        child.score.store(0, std::memory_order_relaxed);
+        child.firstChild = 0;
+        child.state.store(MCTSNode::LEAF, std::memory_order_relaxed);
+        child.move = col;
+        child.childCount = 0;
+        child.result = game.isWinningMove(col) ? game.getCurrentPlayer() : fills ? -1 : 0;
+    }
+
+    node.firstChild = block;
+    node.childCount = count;
+    node.state.store(MCTSNode::EXPANDED, std::memory_order_release);
+    return true;
+}
+
+// Random game to the end that takes any immediate win, returns the winner (-1 tie)
+template<typename Game>
+int BasicMCTSPlayer<Game>::playout(Game& game, Random& random)
+{
+    int cols = game.getCols();
+    int legal[Game::COLS];
+
+    while(!game.isGameOver())
+    {
+        int count = 0;
+        int move = -1;
+        for(int col = 0; col < cols && move == -1; ++col)
+        {
+            if(game.isColumnFull(col))
+                continue;
+            if(game.isWinningMove(col))
+                move = col;
+            legal[count++] = col;
+        }
+
+        game.dropPiece(move != -1 ? move : legal[random.nextInt(count)]);
+    }
+
+    return game.getWinner();
+}
+
+
+
+//----------------------------------------------------------------------------------------//
+// Board sizes in use
+
+template class BasicMCTSPlayer<Connect4Game>;
+template class BasicMCTSPlayer<Connect4Game8x7>;
+template class BasicMCTSPlayer<Connect4Game9x7>;
+
+static_assert(sizeof(MCTSNode) == 16, "Tree nodes should stay 16 bytes");
@@ -0,0 +1,137 @@
+// Connect 4
+// Monte Carlo tree search header file
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "connect4.h"
+#include "policy.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/*
+MCTS runs random playouts from the leaves of a UCT tree. Nodes live in an
+arena: a fixed block handed out by bumping an index, with all children of a
+node allocated side by side, so there is no per-node new and a node is 16
+bytes. After a real move the chosen child becomes the root and nothing else
+is touched, so the rest of the tree is released in O(1). Its space is taken
+back when the arena runs low, by copying the live subtree into a second
+arena and clearing the first.
+
+Threads share one tree. A thread adds a visit to every node on its way
+down before its playout finishes, which counts as a loss until the result
+arrives (virtual loss), so other threads spread out over other branches.
+*/
+
+// One tree node, the score is kept for the player who made its move
+struct MCTSNode
+{
+    std::atomic<uint32_t> visits;
+    std::atomic<uint32_t> score;      // 2 per win and 1 per draw
+    uint32_t firstChild;              // Valid once state is EXPANDED
+    std::atomic<uint8_t> state;
+    int8_t move;
+    uint8_t childCount;
+    int8_t result;                    // Winner if the game ended on this move (-1 tie), 0 still playing
+
+    static const uint8_t LEAF = 0;
+    static const uint8_t EXPANDING = 1;
+    static const uint8_t EXPANDED = 2;
+};
+
+// Fixed-capacity node storage, nodes are only ever freed all at once
+class MCTSArena
+{
+    public:
+        static const uint32_t NONE = UINT32_MAX;
+
+        MCTSArena(uint32_t capacity);
+
+        uint32_t allocate(uint32_t count); // Index of the first node, NONE when full
+        void clear();                      // Releases every node in O(1)
+
+        MCTSNode& operator[](uint32_t index);
+        const MCTSNode& operator[](uint32_t index) const;
+
+        uint32_t getUsed() const;
+        uint32_t getCapacity() const;
+
+    private:
+        std::unique_ptr<MCTSNode[]> nodes;
+        uint32_t capacity;
+        std::atomic<uint32_t> used;
+};
+
+// Results of the last search
+struct MCTSStats
+{
+    unsigned long long playouts;
+    double seconds;
+    uint32_t treeNodes;        // Nodes allocated in the arena, live or not
+    uint32_t reusedVisits;     // Root visits carried over from earlier searches
+    size_t bytesPerNode;
+    size_t arenaBytes;         // Memory held by both arenas
+
+    double getPlayoutsPerSecond() const;
+};
+
+// UCT player that keeps its tree from move to move
+template<typename Game>
+class BasicMCTSPlayer
+{
+    public:
+        static const uint32_t DEFAULT_CAPACITY = 1 << 21; // Nodes per arena
+
+        BasicMCTSPlayer(int threads = 1, uint32_t capacity = DEFAULT_CAPACITY, uint64_t seed = 1);
+
+        BasicMCTSPlayer(const BasicMCTSPlayer&) = delete;
+        BasicMCTSPlayer& operator=(const BasicMCTSPlayer&) = delete;
+
+        // Search until the time runs out or the playouts are done (0 for no limit, one must be set),
+        // the tree is reused when the game continues the position of the last search
+        int search(const Game& game, int moveTimeMs, unsigned long long maxPlayouts = 0);
+        void advance(int col); // Make the child the root, the rest of the tree is dropped
+        void reset(const Game& game);
+
+        // Setters
+        void setThreadCount(int threads);
+        void setExploration(double c);
+
+        // Getters
+        const MCTSStats& getStats() const;
+        int getThreadCount() const;
+
+    private:
+        MCTSArena arenas[2];
+        int active;             // Arena the tree is in
+        uint32_t root;
+        Game rootGame;
+        int threadCount;
+        double exploration;
+        uint64_t seed;
+        MCTSStats stats;
+
+        // Helper methods
+        MCTSArena& tree();
+        uint32_t newRoot();
+        void compact();
+        void runWorker(Random& random, std::atomic<unsigned long long>& playouts, unsigned long long maxPlayouts,
+                       std::chrono::steady_clock::time_point deadline);
+        void runPlayout(Random& random);
+        uint32_t selectChild(const MCTSNode& node) const;
+        bool expand(MCTSNode& node, const Game& game);
+        static int playout(Game& game, Random& random);
+};
+
+using MCTSPlayer = BasicMCTSPlayer<Connect4Game>;
+using MCTSPlayer8x7 = BasicMCTSPlayer<Connect4Game8x7>;
+using MCTSPlayer9x7 = BasicMCTSPlayer<Connect4Game9x7>;
+
+// Compiled once in mcts.cpp
+extern template class BasicMCTSPlayer<Connect4Game>;
+extern template class BasicMCTSPlayer<Connect4Game8x7>;
+extern template class BasicMCTSPlayer<Connect4Game9x7>;
+
+#endif
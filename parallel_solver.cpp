@@ -0,0 +1,501 @@
+// Connect 4
+// Contains function implementations for the multi-threaded solver
+
+#include "parallel_solver.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+
+// A position in the split part of the tree, tested against "score > target"
+struct ParallelSolver::Node
+{
+    Connect4Game game;
+    Node* parent;
+    int depth;                   // Plies below the root
+    int target;
+    std::atomic<bool> resolved;  // The test has been answered
+    bool above;                  // The answer, valid once resolved
+    std::atomic<int> pending;    // Children that have not answered yet
+    std::vector<int> youngerCols; // Moves queued once the first child answers
+    std::atomic<bool> youngerQueued; // Set by the one child that queues them
+};
+
+// Data shared by every worker during one null window test
+struct ParallelSolver::SearchState
+{
+    // Each worker's task queue, guarded by its own lock
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque<Node*> tasks;
+    };
+
+    int cells;
+    std::deque<Node> nodes; // emplace_back keeps pointers to earlier nodes valid
+    std::mutex nodesLock;
+    std::deque<WorkQueue> queues;
+    std::atomic<int> queuedTasks; // In every queue together
+    std::atomic<int> idleWorkers;
+    std::atomic<bool> done;
+
+    // Idle workers sleep here until a task is queued or the test is answered
+    std::mutex idleLock;
+    std::condition_variable wake;
+};
+
+ParallelSolver::ParallelSolver(int threads, size_t tableMB): table(tableMB), book(nullptr), endgame(nullptr), splitDepth(DEFAULT_SPLIT_DEPTH),
+    currentTest(nullptr), testNumber(0), busyWorkers(0), stopping(false)
+{
+    setThreadCount(threads);
+}
+
+ParallelSolver::~ParallelSolver()
+{
+    stopPool();
+}
+
+
+
+// Analysis
+//----------------------------------------------------------------------------------------//
+
+// Find the exact score and a best move for the current position
+SolverResult ParallelSolver::solve(const Connect4Game& game)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    table.newSearch();
+    solvers.clear();
+    for(int i = 0; i < threadCount; ++i)
+    {
+        solvers.emplace_back(new Connect4Solver(&table));
+        solvers.back()->setBook(book);
+        solvers.back()->setEndgameTable(endgame);
+    }
+
+    columnOrder.clear();
+    for(int i = 0; i < game.getCols(); ++i)
+        columnOrder.push_back(game.getCols() / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2);
+
+    SolverResult result;
+    int cells = game.getRows() * game.getCols();
+    int moveCount = game.getMoveCount();
+
+    int bookValue, bookMove;
+    bool inBook = solvers[0]->lookupStored(game, bookValue, bookMove);
+
+    if(game.isGameOver() || inBook)
+    {
+        // Finished games and book positions need no parallel search
+        result = solvers[0]->solve(game);
+    }
+    else
+    {
+        // Same null window probes as the single-threaded solver
+        int min = -(cells - moveCount) / 2;
+        int max = (cells + 1 - moveCount) / 2;
+
+        while(min < max)
+        {
+            int med = min + (max - min) / 2;
+            if(med <= 0 && min / 2 < med)
+                med = min / 2;
+            else if(med >= 0 && max / 2 > med)
+                med = max / 2;
+
+            if(isScoreAbove(game, med))
+                min = med + 1;
+            else
+                max = med;
+        }
+        result.score = min;
+
+        // First move in center-first order whose position scores no better than -score for the opponent
+        result.bestMove = -1;
+        for(int col : columnOrder)
+        {
+            if(game.isColumnFull(col))
+                continue;
+
+            if(game.isWinningMove(col))
+            {
+                result.bestMove = col;
+                break;
+            }
+
+            Connect4Game next = game;
+            next.dropPiece(col);
+            if(!isScoreAbove(next, -result.score))
+            {
+                result.bestMove = col;
+                break;
+            }
+        }
+    }
+
+    result.nodeCount = 0;
+    for(const std::unique_ptr<Connect4Solver>& solver : solvers)
+        result.nodeCount += solver->getNodeCount();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+
+    return result;
+}
+
+// Forget cached positions
+void ParallelSolver::reset()
+{
+    table.clear();
+}
+
+
+
+// Setters
+//----------------------------------------------------------------------------------------//
+
+void ParallelSolver::setBook(const OpeningBook* openingBook)
+{
+    book = openingBook;
+}
+
+void ParallelSolver::setEndgameTable(const OpeningBook* table)
+{
+    endgame = table;
+}
+
+void ParallelSolver::setThreadCount(int threads)
+{
+    if(threads <= 0)
+        threads = std::thread::hardware_concurrency();
+
+    stopPool(); // Restarted with the new size by the next test
+    threadCount = (threads > 0) ? threads : 1;
+}
+
+void ParallelSolver::setSplitDepth(int plies)
+{
+    splitDepth = (plies > 1) ? plies : 1; // The root is always split
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+int ParallelSolver::getThreadCount() const
+{
+    return threadCount;
+}
+
+int ParallelSolver::getSplitDepth() const
+{
+    return splitDepth;
+}
+
+const TranspositionTable& ParallelSolver::getTable() const
+{
+    return table;
+}
+
+
+
+// Private Helper Methods
+//----------------------------------------------------------------------------------------//
+
+// Test "score > value" for a position on every worker
+bool ParallelSolver::isScoreAbove(const Connect4Game& game, int value)
+{
+    SearchState state;
+    state.cells = game.getRows() * game.getCols();
+    state.queues.resize(threadCount);
+    state.queuedTasks = 1;
+    state.idleWorkers = 0;
+    state.done = false;
+
+    // The root is the first task
+    state.nodes.emplace_back();
+    Node* root = &state.nodes.back();
+    root->game = game;
+    root->parent = nullptr;
+    root->depth = 0;
+    root->target = value;
+    root->resolved = false;
+    root->above = false;
+    root->youngerQueued = false;
+    state.queues[0].tasks.push_back(root);
+
+    // Hand the test to the pool and work on it here as worker 0
+    if(pool.size() + 1 != static_cast<size_t>(threadCount))
+        startPool();
+    {
+        std::lock_guard<std::mutex> guard(poolLock);
+        currentTest = &state;
+        ++testNumber;
+        busyWorkers = pool.size();
+    }
+    poolWake.notify_all();
+
+    workerLoop(state, 0);
+
+    // The state lives on this stack, so wait until no pool worker can touch it
+    std::unique_lock<std::mutex> guard(poolLock);
+    poolDone.wait(guard, [&]() { return busyWorkers == 0; });
+    currentTest = nullptr;
+
+    return root->above;
+}
+
+// Workers 1 and up, each waits for a test, runs it and waits for the next
+void ParallelSolver::startPool()
+{
+    stopPool();
+    stopping = false;
+    for(int i = 1; i < threadCount; ++i)
+        pool.emplace_back(&ParallelSolver::poolLoop, this, i, testNumber); // Only this thread moves testNumber on
+}
+
+void ParallelSolver::stopPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(poolLock);
+        stopping = true;
+    }
+    poolWake.notify_all();
+    for(std::thread& worker : pool)
+        worker.join();
+    pool.clear();
+}
+
+void ParallelSolver::poolLoop(int id, unsigned seen)
+{
+    while(true)
+    {
+        SearchState* state;
+        {
+            std::unique_lock<std::mutex> guard(poolLock);
+            poolWake.wait(guard, [&]() { return stopping || testNumber != seen; });
+            if(stopping)
+                return;
+            seen = testNumber;
+            state = currentTest;
+        }
+
+        workerLoop(*state, id);
+
+        std::lock_guard<std::mutex> guard(poolLock);
+        if(--busyWorkers == 0)
+            poolDone.notify_all();
+    }
+}
+
+// Run tasks until the root test is answered
+void ParallelSolver::workerLoop(SearchState& state, int id)
+{
+    bool idle = false;
+
+    while(!state.done)
+    {
+        Node* task = takeTask(state, id);
+        if(!task)
+        {
+            if(!idle)
+            {
+                idle = true;
+                ++state.idleWorkers;
+            }
+
+            // Tasks are counted before the lock is taken to announce them, so none is missed
+            std::unique_lock<std::mutex> guard(state.idleLock);
+            state.wake.wait(guard, [&]() { return state.done || state.queuedTasks > 0; });
+            continue;
+        }
+
+        if(idle)
+        {
+            idle = false;
+            --state.idleWorkers;
+        }
+
+        // A sibling already answered the parent's test
+        if(isCancelled(task))
+            continue;
+
+        // Split shallow positions while other workers have nothing to do
+        if(task->depth == 0 || (task->depth < splitDepth && state.idleWorkers > 0))
+            expand(state, task, id);
+        else
+        {
+            // Abandoned as soon as the test or any position above the task is answered
+            Connect4Solver& solver = *solvers[id];
+            solver.setStop([&]() { return state.done || isCancelled(task); });
+            int r = solver.searchWindow(task->game, task->target, task->target + 1);
+            solver.setStop(nullptr);
+            if(!solver.wasStopped())
+                complete(state, task, r > task->target, id);
+        }
+    }
+}
+
+// Newest task from our own queue, otherwise the oldest task of another worker
+ParallelSolver::Node* ParallelSolver::takeTask(SearchState& state, int id)
+{
+    {
+        SearchState::WorkQueue& own = state.queues[id];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty())
+        {
+            Node* task = own.tasks.back();
+            own.tasks.pop_back();
+            --state.queuedTasks;
+            return task;
+        }
+    }
+
+    for(int i = 1; i < threadCount; ++i)
+    {
+        SearchState::WorkQueue& victim = state.queues[(id + i) % threadCount];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(!victim.tasks.empty())
+        {
+            Node* task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --state.queuedTasks;
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+void ParallelSolver::pushTask(SearchState& state, int id, Node* node)
+{
+    {
+        SearchState::WorkQueue& own = state.queues[id];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.tasks.push_back(node);
+        ++state.queuedTasks;
+    }
+
+    if(state.idleWorkers > 0)
+    {
+        std::lock_guard<std::mutex> guard(state.idleLock);
+        state.wake.notify_one();
+    }
+}
+
+// Create the position after playing col, testing the opponent's side of the parent's test:
+// parent score > t exactly when some child score < -t, i.e. not (child score > -t - 1)
+ParallelSolver::Node* ParallelSolver::addChild(SearchState& state, Node* parent, int col)
+{
+    std::lock_guard<std::mutex> guard(state.nodesLock);
+
+    state.nodes.emplace_back();
+    Node* child = &state.nodes.back();
+    child->game = parent->game;
+    child->game.dropPiece(col);
+    child->parent = parent;
+    child->depth = parent->depth + 1;
+    child->target = -parent->target - 1;
+    child->resolved = false;
+    child->above = false;
+    child->youngerQueued = false;
+
+    return child;
+}
+
+// Split a position into one task per legal move, starting with the eldest
+void ParallelSolver::expand(SearchState& state, Node* node, int id)
+{
+    const Connect4Game& game = node->game;
+
+    // Finished games and immediate wins are answered straight away
+    if(game.isGameOver())
+    {
+        complete(state, node, solvers[id]->scorePosition(game) > node->target, id);
+        return;
+    }
+
+    if(game.canWinNext())
+    {
+        complete(state, node, (state.cells + 1 - game.getMoveCount()) / 2 > node->target, id);
+        return;
+    }
+
+    // Moves that hand the opponent a win are never split off
+    Connect4Game::Bitboard moves = game.getNonLosingMoves();
+    if(!moves)
+    {
+        complete(state, node, -(state.cells - game.getMoveCount()) / 2 > node->target, id);
+        return;
+    }
+
+    std::vector<int> cols;
+    for(int col : columnOrder)
+    {
+        if(moves & Connect4Game::columnMask(col))
+            cols.push_back(col);
+    }
+
+    // The younger brothers wait until the eldest child has answered
+    node->pending = cols.size();
+    node->youngerCols.assign(cols.begin() + 1, cols.end());
+    pushTask(state, id, addChild(state, node, cols[0]));
+}
+
+// Record an answer and pass it up the tree
+void ParallelSolver::complete(SearchState& state, Node* node, bool above, int id)
+{
+    while(true)
+    {
+        if(node->resolved.exchange(true))
+            return; // Answered already
+
+        node->above = above;
+
+        Node* parent = node->parent;
+        if(!parent)
+        {
+            std::lock_guard<std::mutex> guard(state.idleLock);
+            state.done = true;
+            state.wake.notify_all();
+            return;
+        }
+
+        // A child that stays at or below its target answers the parent's test
+        if(!above)
+        {
+            node = parent;
+            above = true;
+            continue;
+        }
+
+        // The first child to get here (the eldest, as the others are queued by it) queues its
+        // brothers, center moves are taken first
+        if(!parent->youngerQueued.exchange(true))
+        {
+            const std::vector<int>& younger = parent->youngerCols;
+            for(auto it = younger.rbegin(); it != younger.rend(); ++it)
+                pushTask(state, id, addChild(state, parent, *it));
+        }
+
+        if(--parent->pending > 0)
+            return; // Other children are still being searched
+
+        // Every child stayed above its target, so the parent doesn't pass its test
+        node = parent;
+        above = false;
+    }
+}
+
+// A queued task is no longer needed once any position above it is answered
+bool ParallelSolver::isCancelled(const Node* node) const
+{
+    for(; node; node = node->parent)
+    {
+        if(node->resolved)
+            return true;
+    }
+
+    return false;
+}
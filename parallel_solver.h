@@ -0,0 +1,90 @@
+// Connect 4
+// Multi-threaded solver header file
+
+#ifndef PARALLEL_SOLVER_H
+#define PARALLEL_SOLVER_H
+
+#include "solver.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*
+The parallel solver finds the exact score with the same series of null window
+tests as Connect4Solver, but runs each test on several threads. A test asks
+"is the score above some value?" and splits into one task per move. Workers
+keep their own task queue and steal from the others when it runs dry.
+
+The root is always split; positions down to the split depth are split further
+while some worker is idle, everything else is searched by a Connect4Solver.
+Like sequential alpha-beta, the first (center) move of a split position is
+tested before its younger brothers are queued, and a move that answers the
+test cancels its siblings, both queued ones and those already being searched
+(a running search checks every STOP_INTERVAL nodes whether it is still needed). All workers share one transposition table.
+The worker threads are started once and kept between tests, and a worker
+with nothing to do sleeps until a task is queued or the test is answered.
+*/
+
+// Perfect play solver that searches on several threads
+class ParallelSolver
+{
+    public:
+        ParallelSolver(int threads = 0, size_t tableMB = TranspositionTable::DEFAULT_MB); // 0 uses every hardware thread
+        ~ParallelSolver();
+        ParallelSolver(const ParallelSolver&) = delete;
+        ParallelSolver& operator=(const ParallelSolver&) = delete;
+
+        // Analysis
+        SolverResult solve(const Connect4Game& game);
+        void reset(); // Forget cached positions
+
+        // Setters
+        void setBook(const OpeningBook* openingBook); // Checked before any search
+        void setEndgameTable(const OpeningBook* table);
+        void setThreadCount(int threads);
+        void setSplitDepth(int plies);
+
+        // Getters
+        int getThreadCount() const;
+        int getSplitDepth() const;
+        const TranspositionTable& getTable() const;
+
+        static const int DEFAULT_SPLIT_DEPTH = 4;
+
+    private:
+        struct Node;
+        struct SearchState;
+
+        TranspositionTable table;
+        std::vector<std::unique_ptr<Connect4Solver>> solvers; // One per worker
+        std::vector<int> columnOrder;
+        const OpeningBook* book;
+        const OpeningBook* endgame;
+        int threadCount;
+        int splitDepth;
+
+        // Worker pool, the calling thread is worker 0 and the pool runs the others
+        std::vector<std::thread> pool;
+        std::mutex poolLock;
+        std::condition_variable poolWake; // A test started or the pool is stopping
+        std::condition_variable poolDone; // Every pool worker left the current test
+        SearchState* currentTest;
+        unsigned testNumber;
+        int busyWorkers;                  // Pool workers still in the current test
+        bool stopping;
+
+        // Helper methods
+        bool isScoreAbove(const Connect4Game& game, int value);
+        void startPool();
+        void stopPool();
+        void poolLoop(int id, unsigned seen);
+        void workerLoop(SearchState& state, int id);
+        Node* takeTask(SearchState& state, int id);
+        void pushTask(SearchState& state, int id, Node* node);
+        Node* addChild(SearchState& state, Node* parent, int col);
+        void expand(SearchState& state, Node* node, int id);
+        void complete(SearchState& state, Node* node, bool above, int id);
+        bool isCancelled(const Node* node) const;
+};
+
+#endif
@@ -0,0 +1,218 @@
+// Connect 4
+// Contains function implementations for the performance counters and timers
+
+#include "perf.h"
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Every live thread's slots plus the totals of threads that have finished
+struct PerfRegistry
+{
+    std::mutex lock;
+    std::vector<PerfThreadData*> threads;
+    PerfSnapshot retired = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+// Never destroyed, threads may still finish while the program exits
+static PerfRegistry& registry()
+{
+    static PerfRegistry* instance = new PerfRegistry();
+    return *instance;
+}
+
+static void addTo(PerfSnapshot& totals, const PerfThreadData& data)
+{
+    for(int i = 0; i < PERF_COUNTERS; ++i)
+        totals.counters[i] += data.counters[i].load(std::memory_order_relaxed);
+    for(int i = 0; i < PERF_TIMERS; ++i)
+    {
+        totals.timerNanos[i] += data.timerNanos[i].load(std::memory_order_relaxed);
+        totals.timerCalls[i] += data.timerCalls[i].load(std::memory_order_relaxed);
+    }
+}
+
+// Registers a thread's slots on first use and folds them into the totals when it ends
+struct PerfThreadSlot
+{
+    PerfThreadData data = {};
+
+    PerfThreadSlot()
+    {
+        PerfRegistry& shared = registry();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        shared.threads.push_back(&data);
+    }
+
+    ~PerfThreadSlot()
+    {
+        PerfRegistry& shared = registry();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        addTo(shared.retired, data);
+        for(size_t i = 0; i < shared.threads.size(); ++i)
+        {
+            if(shared.threads[i] == &data)
+            {
+                shared.threads[i] = shared.threads.back();
+                shared.threads.pop_back();
+                break;
+            }
+        }
+    }
+};
+
+
+
+// Perf
+//----------------------------------------------------------------------------------------//
+
+PerfThreadData& Perf::threadData()
+{
+    thread_local PerfThreadSlot slot;
+    return slot.data;
+}
+
+bool Perf::isEnabled()
+{
+#ifdef C4_PERF
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Add up every thread, live or finished
+PerfSnapshot Perf::snapshot()
+{
+    PerfRegistry& shared = registry();
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    PerfSnapshot totals = shared.retired;
+    for(const PerfThreadData* data : shared.threads)
+        addTo(totals, *data);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - shared.start;
+    totals.seconds = elapsed.count();
+
+    return totals;
+}
+
+// {"seconds": s, "counters": {...}, "timers": {"name": {"calls": n, "ms": t}, ...}}
+void Perf::writeJson(std::ostream& out, const PerfSnapshot& snapshot)
+{
+    out << "{\n  \"enabled\": " << (isEnabled() ? "true" : "false") << ",\n  \"seconds\": " << snapshot.seconds
+        << ",\n  \"counters\": {";
+    for(int i = 0; i < PERF_COUNTERS; ++i)
+    {
+        out << (i ? ", " : "") << "\"" << getName(static_cast<PerfCounter>(i)) << "\": " << snapshot.counters[i];
+    }
+    out << "},\n  \"timers\": {";
+    for(int i = 0; i < PERF_TIMERS; ++i)
+    {
+        out << (i ? ", " : "") << "\"" << getName(static_cast<PerfTimer>(i)) << "\": {\"calls\": "
+            << snapshot.timerCalls[i] << ", \"ms\": " << snapshot.timerNanos[i] / 1e6 << "}";
+    }
+    out << "}\n}" << std::endl;
+}
+
+const char* Perf::getName(PerfCounter counter)
+{
+    switch(counter)
+    {
+        case PerfCounter::Drops:
+            return "drops";
+        case PerfCounter::WinChecks:
+            return "win_checks";
+        case PerfCounter::Nodes:
+            return "nodes";
+        case PerfCounter::TableHits:
+            return "table_hits";
+        case PerfCounter::TableMisses:
+            return "table_misses";
+        default:
+            return "unknown";
+    }
+}
+
+const char* Perf::getName(PerfTimer timer)
+{
+    switch(timer)
+    {
+        case PerfTimer::Input:
+            return "input";
+        case PerfTimer::DrawBoard:
+            return "draw_board";
+        case PerfTimer::DrawStatus:
+            return "draw_status";
+        case PerfTimer::EndDrawing:
+            return "end_drawing";
+        default:
+            return "unknown";
+    }
+}
+
+
+
+// ScopedPerfTimer
+//----------------------------------------------------------------------------------------//
+
+ScopedPerfTimer::ScopedPerfTimer(PerfTimer timer): timer(timer), start(std::chrono::steady_clock::now()), running(true)
+{
+}
+
+ScopedPerfTimer::~ScopedPerfTimer()
+{
+    stop();
+}
+
+void ScopedPerfTimer::stop()
+{
+    if(!running)
+        return;
+
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    Perf::addTime(timer, elapsed.count());
+    running = false;
+}
+
+
+
+// PerfReporter
+//----------------------------------------------------------------------------------------//
+
+PerfReporter::PerfReporter(const std::string& path, int intervalMs): path(path), intervalMs(intervalMs), stopping(false)
+{
+    thread = std::thread(&PerfReporter::run, this);
+}
+
+PerfReporter::~PerfReporter()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    write();
+}
+
+void PerfReporter::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while(!wake.wait_for(guard, std::chrono::milliseconds(intervalMs), [this]() { return stopping; }))
+        write();
+}
+
+// Write to a temporary file and rename it, so readers never see half a snapshot
+void PerfReporter::write() const
+{
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if(!file)
+            return;
+        Perf::writeJson(file, Perf::snapshot());
+    }
+    std::rename(temporary.c_str(), path.c_str());
+}
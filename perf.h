@@ -0,0 +1,154 @@
+// Connect 4
+// Performance counters and timers header file
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/*
+Counters and timers are only compiled in when C4_PERF is defined
+(make DEFINES=-DC4_PERF); otherwise the PERF_ macros expand to nothing and
+the game code pays nothing for them. Every thread counts into its own slots,
+so counting never needs a lock or a shared cache line. snapshot() adds up
+all threads on demand, including threads that have already finished.
+*/
+
+// Counted events
+enum class PerfCounter
+{
+    Drops,       // Connect4Game::dropPiece calls
+    WinChecks,   // Win detections (checkWinner, checkWinFromPosition, isWinningMove)
+    Nodes,       // Positions visited by any search
+    TableHits,   // Transposition table lookups that found the position
+    TableMisses,
+    COUNT
+};
+
+// Timed sections, mostly the phases of a frame
+enum class PerfTimer
+{
+    Input,
+    DrawBoard,
+    DrawStatus,
+    EndDrawing,
+    COUNT
+};
+
+const int PERF_COUNTERS = static_cast<int>(PerfCounter::COUNT);
+const int PERF_TIMERS = static_cast<int>(PerfTimer::COUNT);
+
+// Totals over every thread at one moment
+struct PerfSnapshot
+{
+    uint64_t counters[PERF_COUNTERS];
+    uint64_t timerNanos[PERF_TIMERS];
+    uint64_t timerCalls[PERF_TIMERS];
+    double seconds; // Since the program started
+};
+
+// One thread's slots, only ever written by that thread
+struct PerfThreadData
+{
+    std::atomic<uint64_t> counters[PERF_COUNTERS];
+    std::atomic<uint64_t> timerNanos[PERF_TIMERS];
+    std::atomic<uint64_t> timerCalls[PERF_TIMERS];
+};
+
+// Process wide counters and timers
+class Perf
+{
+    public:
+        // Recording (use the PERF_ macros so it compiles out)
+        static void add(PerfCounter counter, uint64_t amount = 1);
+        static void addTime(PerfTimer timer, uint64_t nanos);
+
+        // Reporting
+        static bool isEnabled(); // Built with C4_PERF
+        static PerfSnapshot snapshot();
+        static void writeJson(std::ostream& out, const PerfSnapshot& snapshot);
+        static const char* getName(PerfCounter counter);
+        static const char* getName(PerfTimer timer);
+
+    private:
+        static PerfThreadData& threadData();
+};
+
+// Adds the time until it goes out of scope to a timer
+class ScopedPerfTimer
+{
+    public:
+        ScopedPerfTimer(PerfTimer timer);
+        ~ScopedPerfTimer();
+
+        void stop(); // End the section early
+
+    private:
+        PerfTimer timer;
+        std::chrono::steady_clock::time_point start;
+        bool running;
+};
+
+// Rewrites a JSON snapshot file every interval on a background thread
+class PerfReporter
+{
+    public:
+        PerfReporter(const std::string& path, int intervalMs = 1000);
+        ~PerfReporter(); // Writes one last snapshot
+
+        PerfReporter(const PerfReporter&) = delete;
+        PerfReporter& operator=(const PerfReporter&) = delete;
+
+    private:
+        std::string path;
+        int intervalMs;
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping;
+
+        void run();
+        void write() const;
+};
+
+// Single thread counting has no contention, a relaxed load and store is enough
+inline void Perf::add(PerfCounter counter, uint64_t amount)
+{
+    std::atomic<uint64_t>& slot = threadData().counters[static_cast<int>(counter)];
+    slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void Perf::addTime(PerfTimer timer, uint64_t nanos)
+{
+    PerfThreadData& data = threadData();
+    std::atomic<uint64_t>& total = data.timerNanos[static_cast<int>(timer)];
+    std::atomic<uint64_t>& calls = data.timerCalls[static_cast<int>(timer)];
+    total.store(total.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+    calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+#define PERF_JOIN2(a, b) a##b
+#define PERF_JOIN(a, b) PERF_JOIN2(a, b)
+
+#ifdef C4_PERF
+#define PERF_COUNT(counter) Perf::add(PerfCounter::counter)
+#define PERF_ADD(counter, amount) Perf::add(PerfCounter::counter, amount)
+#define PERF_TIMER(timer) ScopedPerfTimer PERF_JOIN(perfTimer, __LINE__)(PerfTimer::timer)
+#define PERF_BEGIN(timer) ScopedPerfTimer perfSection##timer(PerfTimer::timer)
+#define PERF_END(timer) perfSection##timer.stop()
+#else
+#define PERF_COUNT(counter) ((void)0)
+#define PERF_ADD(counter, amount) ((void)0)
+#define PERF_TIMER(timer) ((void)0)
+#define PERF_BEGIN(timer) ((void)0)
+#define PERF_END(timer) ((void)0)
+#endif
+
+#endif
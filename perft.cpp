@@ -0,0 +1,405 @@
+// Connect 4
+// Perft: counts every legal move sequence to a depth, to check and time the move code
+//
+// A sequence stops when a move wins or fills the board, so positions that are
+// over are counted at their own depth and never expanded. For every depth up
+// to N it prints the sequences, how many of them end in a win or a draw on
+// their last move, and leaf nodes/sec. The walk plays and undoes every move
+// with Connect4Game, so the numbers cover move generation, win detection and
+// undo together.
+//
+// Options:
+//   -d N        depth (default 9)
+//   -p moves    start position as a move string, columns from 1 (default the empty board)
+//   -t N        worker threads (default 1)
+//   -H MB       transposition table per thread: positions already counted to the same
+//               depth are looked up, mirror images included (default 0, off)
+//   --divide    also print the sequences below each first move at the last depth
+//   --unique    count distinct positions per ply instead of sequences
+//   --check     compare the counts from the empty board with the reference values,
+//               exit with 2 on a mismatch
+
+#include "connect4.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using std::cout, std::cerr, std::endl;
+
+using Game = Connect4Game;
+
+// Move sequences from the empty board: 7^n until a column can fill, 7^7 less the
+// 7 games that stacked one column, then the published perft counts
+const unsigned long long REFERENCE_SEQUENCES[] = {1, 7, 49, 343, 2401, 16807, 117649, 823536, 5673234, 39394572,
+                                                  268031646};
+
+// Distinct positions after n plies (OEIS A212693, John Tromp)
+const unsigned long long REFERENCE_POSITIONS[] = {1, 7, 49, 238, 1120, 4263, 16422, 54859, 184275, 558186,
+                                                  1662623, 4568683, 12236101, 30929111};
+
+// Leaves below a position and how their last move ended the game
+struct PerftCounts
+{
+    unsigned long long nodes = 0;
+    unsigned long long wins = 0;
+    unsigned long long draws = 0;
+
+    PerftCounts& operator+=(const PerftCounts& other)
+    {
+        nodes += other.nodes;
+        wins += other.wins;
+        draws += other.draws;
+        return *this;
+    }
+};
+
+// Counts below a position for one depth, always-replace, one per thread so it needs no locks
+class PerftTable
+{
+    public:
+        PerftTable(size_t megabytes): entries(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Entry), 1)) {}
+
+        bool lookup(uint64_t key, int depth, PerftCounts& counts) const
+        {
+            const Entry& entry = entries[slot(key, depth)];
+            if(entry.tag != tag(key, depth))
+                return false;
+
+            counts = entry.counts;
+            return true;
+        }
+
+        void store(uint64_t key, int depth, const PerftCounts& counts)
+        {
+            Entry& entry = entries[slot(key, depth)];
+            entry.tag = tag(key, depth);
+            entry.counts = counts;
+        }
+
+    private:
+        struct Entry
+        {
+            uint64_t tag = 0; // 0 is never a tag, the empty board is not stored
+            PerftCounts counts;
+        };
+
+        std::vector<Entry> entries;
+
+        // Keys use 49 bits, which leaves room for the depth
+        static uint64_t tag(uint64_t key, int depth)
+        {
+            return key << 6 | static_cast<uint64_t>(depth);
+        }
+
+        size_t slot(uint64_t key, int depth) const
+        {
+            return (tag(key, depth) * 0x9E3779B97F4A7C15ULL >> 17) % entries.size();
+        }
+};
+static_assert(Game::ROWS * Game::COLS + Game::COLS <= 58, "Perft table tags need the key and depth in 64 bits");
+
+PerftCounts perft(Game& game, int depth, PerftTable* table)
+{
+    PerftCounts counts;
+    if(depth == 0)
+    {
+        counts.nodes = 1;
+        return counts;
+    }
+
+    // A position and its mirror image have the same counts
+    uint64_t key = 0;
+    if(table && depth > 1)
+    {
+        key = game.getCanonicalKey();
+        if(table->lookup(key, depth, counts))
+            return counts;
+    }
+
+    for(int col = 0; col < Game::COLS; ++col)
+    {
+        if(!game.dropPiece(col))
+            continue;
+
+        if(depth == 1)
+        {
+            ++counts.nodes;
+            int winner = game.getWinner();
+            if(winner > 0)
+                ++counts.wins;
+            else if(winner == -1)
+                ++counts.draws;
+        }
+        else if(!game.isGameOver())
+            counts += perft(game, depth - 1, table);
+
+        game.undoMove();
+    }
+
+    if(table && depth > 1)
+        table->store(key, depth, counts);
+    return counts;
+}
+
+// A position at the split depth, searched by whichever thread takes it
+struct PerftTask
+{
+    Game game;
+    int firstMove;
+    PerftCounts counts;
+};
+
+// Positions split plies below the start, or the start itself once the game is over
+void collectTasks(Game& game, int split, int firstMove, std::vector<PerftTask>& tasks)
+{
+    if(split == 0 || game.isGameOver())
+    {
+        tasks.push_back(PerftTask{game, firstMove, PerftCounts()});
+        return;
+    }
+
+    for(int col = 0; col < Game::COLS; ++col)
+    {
+        if(!game.dropPiece(col))
+            continue;
+        collectTasks(game, split - 1, firstMove < 0 ? col : firstMove, tasks);
+        game.undoMove();
+    }
+}
+
+// Counts at one depth on several threads, per first move in divide
+PerftCounts parallelPerft(const Game& start, int depth, int threads, std::vector<std::unique_ptr<PerftTable>>& tables,
+                          PerftCounts* divide)
+{
+    // A few hundred tasks keep the threads busy to the end
+    int split = std::min(depth, 3);
+    Game game = start;
+    std::vector<PerftTask> tasks;
+    collectTasks(game, split, -1, tasks);
+
+    std::atomic<size_t> next(0);
+    auto worker = [&](int id)
+    {
+        PerftTable* table = tables.empty() ? nullptr : tables[id].get();
+        for(size_t i = next++; i < tasks.size(); i = next++)
+        {
+            PerftTask& task = tasks[i];
+            int remaining = depth - task.game.getMoveCount() + start.getMoveCount();
+            if(task.game.isGameOver() && remaining > 0)
+                continue; // Ended before the depth, no leaves below it
+
+            // A task that ended on its last move is its own leaf
+            if(remaining == 0)
+            {
+                task.counts.nodes = 1;
+                int winner = task.game.getWinner();
+                task.counts.wins = winner > 0;
+                task.counts.draws = winner == -1;
+            }
+            else
+                task.counts = perft(task.game, remaining, table);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 1; i < threads; ++i)
+        workers.emplace_back(worker, i);
+    worker(0);
+    for(std::thread& w : workers)
+        w.join();
+
+    PerftCounts total;
+    for(const PerftTask& task : tasks)
+    {
+        total += task.counts;
+        if(divide && task.firstMove >= 0)
+            divide[task.firstMove] += task.counts;
+    }
+
+    return total;
+}
+
+// Open addressing set of position keys, grown as it fills
+class PositionSet
+{
+    public:
+        PositionSet(): slots(1 << 16, 0), count(0) {}
+
+        bool insert(uint64_t key)
+        {
+            if(2 * (count + 1) > slots.size())
+                grow();
+            if(!place(slots, key + 1))
+                return false;
+            ++count;
+            return true;
+        }
+
+    private:
+        std::vector<uint64_t> slots; // Key + 1, 0 is empty
+        size_t count;
+
+        static bool place(std::vector<uint64_t>& table, uint64_t value)
+        {
+            size_t mask = table.size() - 1;
+            for(size_t i = (value * 0x9E3779B97F4A7C15ULL) >> 20 & mask;; i = (i + 1) & mask)
+            {
+                if(table[i] == value)
+                    return false;
+                if(table[i] == 0)
+                {
+                    table[i] = value;
+                    return true;
+                }
+            }
+        }
+
+        void grow()
+        {
+            std::vector<uint64_t> bigger(slots.size() * 2, 0);
+            for(uint64_t value : slots)
+            {
+                if(value)
+                    place(bigger, value);
+            }
+            slots.swap(bigger);
+        }
+};
+
+// Distinct positions at every ply, a position seen before is not expanded again
+void countPositions(Game& game, int depth, PositionSet& seen, std::vector<unsigned long long>& positions)
+{
+    if(!seen.insert(game.getPositionKey()))
+        return;
+
+    ++positions[game.getMoveCount()];
+    if(depth == 0 || game.isGameOver())
+        return;
+
+    for(int col = 0; col < Game::COLS; ++col)
+    {
+        if(!game.dropPiece(col))
+            continue;
+        countPositions(game, depth - 1, seen, positions);
+        game.undoMove();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int depth = 9;
+    std::string moves;
+    int threads = 1;
+    size_t tableMB = 0;
+    bool divide = false;
+    bool unique = false;
+    bool check = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            depth = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            moves = argv[++i];
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-H") == 0 && i + 1 < argc)
+            tableMB = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--divide") == 0)
+            divide = true;
+        else if(strcmp(argv[i], "--unique") == 0)
+            unique = true;
+        else if(strcmp(argv[i], "--check") == 0)
+            check = true;
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-d depth] [-p moves] [-t threads] [-H MB] [--divide] [--unique] [--check]"
+                 << endl;
+            return 1;
+        }
+    }
+    if(threads < 1)
+        threads = 1;
+    if(depth < 0)
+        depth = 0;
+
+    Game start;
+    if(moves == "-")
+        moves.clear();
+    if(!start.playSequence(moves))
+    {
+        cerr << "Invalid position: " << moves << endl;
+        return 1;
+    }
+    check = check && start.getMoveCount() == 0;
+    int mismatches = 0;
+
+    // Distinct positions
+    if(unique)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        Game game = start;
+        PositionSet seen;
+        std::vector<unsigned long long> positions(Game::ROWS * Game::COLS + 1, 0);
+        countPositions(game, depth, seen, positions);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        cout << "ply  positions" << endl;
+        for(int ply = start.getMoveCount(); ply <= std::min(start.getMoveCount() + depth, Game::ROWS * Game::COLS); ++ply)
+        {
+            cout << ply << "  " << positions[ply];
+            if(check && ply < static_cast<int>(sizeof(REFERENCE_POSITIONS) / sizeof(REFERENCE_POSITIONS[0])))
+            {
+                bool ok = positions[ply] == REFERENCE_POSITIONS[ply];
+                mismatches += !ok;
+                cout << (ok ? "  ok" : "  MISMATCH, expected " + std::to_string(REFERENCE_POSITIONS[ply]));
+            }
+            cout << endl;
+        }
+        cout << "Time: " << elapsed.count() << " s" << endl;
+
+        return mismatches ? 2 : 0;
+    }
+
+    // Move sequences
+    std::vector<std::unique_ptr<PerftTable>> tables;
+    for(int i = 0; i < threads && tableMB > 0; ++i)
+        tables.emplace_back(new PerftTable(tableMB));
+
+    PerftCounts firstMoves[Game::COLS];
+    cout << "depth  nodes  wins  draws  seconds  nodes/sec" << endl;
+    for(int d = 1; d <= depth; ++d)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        PerftCounts counts = parallelPerft(start, d, threads, tables, d == depth ? firstMoves : nullptr);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        double seconds = elapsed.count() > 0 ? elapsed.count() : 1e-9;
+
+        cout << d << "  " << counts.nodes << "  " << counts.wins << "  " << counts.draws << "  " << elapsed.count()
+             << "  " << static_cast<long long>(counts.nodes / seconds);
+        if(check && d < static_cast<int>(sizeof(REFERENCE_SEQUENCES) / sizeof(REFERENCE_SEQUENCES[0])))
+        {
+            bool ok = counts.nodes == REFERENCE_SEQUENCES[d];
+            mismatches += !ok;
+            cout << (ok ? "  ok" : "  MISMATCH, expected " + std::to_string(REFERENCE_SEQUENCES[d]));
+        }
+        cout << endl;
+    }
+
+    if(divide)
+    {
+        for(int col = 0; col < Game::COLS; ++col)
+        {
+            if(firstMoves[col].nodes)
+                cout << col + 1 << ": " << firstMoves[col].nodes << endl;
+        }
+    }
+
+    return mismatches ? 2 : 0;
+}
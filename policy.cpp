@@ -0,0 +1,407 @@
+// Connect 4
+// Contains function implementations for the move policies
+
+#include "policy.h"
+#include "evaluator.h"
+#include "mcts.h"
+#include "perf.h"
+#include <cstdlib>
+#include <utility>
+
+Random::Random(uint64_t seed)
+{
+    // Spread the seed with splitmix64 so nearby seeds give unrelated streams
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    state = (seed ^ (seed >> 31)) | 1; // xorshift state must not be zero
+}
+
+uint64_t Random::next()
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+int Random::nextInt(int bound)
+{
+    return static_cast<int>((next() >> 32) * bound >> 32);
+}
+
+
+
+// Random Policy
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+int BasicRandomPolicy<Game>::chooseMove(const Game& game, Random& random)
+{
+    int legal[16];
+    int count = 0;
+    for(int col = 0; col < game.getCols(); ++col)
+    {
+        if(!game.isColumnFull(col))
+            legal[count++] = col;
+    }
+
+    return count ? legal[random.nextInt(count)] : -1;
+}
+
+template<typename Game>
+std::string BasicRandomPolicy<Game>::getName() const
+{
+    return "random";
+}
+
+
+
+// Greedy Policy
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+int BasicGreedyPolicy<Game>::chooseMove(const Game& game, Random& random)
+{
+    typename Game::Bitboard wins = game.getWinningCells() & game.getPlayableCells();
+    int cols = game.getCols();
+    int safe[16];
+    int safeCount = 0;
+
+    for(int col = 0; col < cols; ++col)
+    {
+        if(wins & Game::columnMask(col))
+            return col;
+    }
+
+    // Moves that leave the opponent an immediate win are not safe,
+    // so when they have a threat only the blocking move is
+    typename Game::Bitboard nonLosing = game.getNonLosingMoves();
+    for(int col = 0; col < cols; ++col)
+    {
+        if(nonLosing & Game::columnMask(col))
+            safe[safeCount++] = col;
+    }
+
+    if(safeCount)
+        return safe[random.nextInt(safeCount)];
+
+    // Every move loses, play anything
+    BasicRandomPolicy<Game> fallback;
+    return fallback.chooseMove(game, random);
+}
+
+template<typename Game>
+std::string BasicGreedyPolicy<Game>::getName() const
+{
+    return "greedy";
+}
+
+
+
+// Search Policy
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+BasicSearchPolicy<Game>::BasicSearchPolicy(int depth, const std::string& weightsPath): depth(depth), weightsPath(weightsPath), stopped(false), score(0)
+{
+    if(weightsPath.empty())
+        return;
+
+    evaluator.reset(new BasicEvaluator<Game>());
+    if(!evaluator->load(weightsPath))
+        evaluator.reset();
+}
+
+template<typename Game>
+BasicSearchPolicy<Game>::~BasicSearchPolicy() = default;
+
+template<typename Game>
+int BasicSearchPolicy<Game>::chooseMove(const Game& game, Random& random)
+{
+    Game position = game;
+    const int cols = game.getCols();
+    int best[16];
+    int bestCount = 0;
+    int bestScore = -1000000;
+    stopped = false;
+    if(evaluator)
+        evaluator->reset(position);
+
+    for(int i = 0; i < cols; ++i)
+    {
+        int col = cols / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2; // Center columns first
+        if(game.isColumnFull(col))
+            continue;
+        if(game.isWinningMove(col))
+        {
+            score = 1000 + game.getRows() * cols - game.getMoveCount();
+            return col;
+        }
+
+        play(position, col);
+        int childScore = -negamax(position, depth - 1, -1000000, -bestScore + 1);
+        undo(position);
+        if(stopped)
+            return -1;
+
+        // Keep every move tied for best and pick one at random
+        if(childScore > bestScore)
+        {
+            bestScore = childScore;
+            bestCount = 0;
+        }
+        if(childScore == bestScore)
+            best[bestCount++] = col;
+    }
+
+    score = bestScore;
+    return bestCount ? best[random.nextInt(bestCount)] : -1;
+}
+
+template<typename Game>
+std::string BasicSearchPolicy<Game>::getName() const
+{
+    if(!weightsPath.empty())
+        return "search:" + std::to_string(depth) + ":" + weightsPath;
+    return "search:" + std::to_string(depth);
+}
+
+template<typename Game>
+bool BasicSearchPolicy<Game>::hasEvaluator() const
+{
+    return static_cast<bool>(evaluator);
+}
+
+template<typename Game>
+void BasicSearchPolicy<Game>::setDepth(int depth)
+{
+    this->depth = depth;
+}
+
+template<typename Game>
+void BasicSearchPolicy<Game>::setStop(std::function<bool()> stop)
+{
+    this->stop = std::move(stop);
+}
+
+template<typename Game>
+bool BasicSearchPolicy<Game>::wasStopped() const
+{
+    return stopped;
+}
+
+template<typename Game>
+int BasicSearchPolicy<Game>::getScore() const
+{
+    return score;
+}
+
+// Wins score 1000 plus the number of empty cells left, so faster wins are preferred.
+// Returns 0 once stopped, the caller throws the result away
+template<typename Game>
+int BasicSearchPolicy<Game>::negamax(Game& game, int depth, int alpha, int beta)
+{
+    PERF_COUNT(Nodes);
+    if(stop && stop())
+    {
+        stopped = true;
+        return 0;
+    }
+
+    const int cols = game.getCols();
+    int cells = game.getRows() * cols;
+    if(game.isGameOver())
+        return 0; // Filled the board, wins are caught before they are played
+
+    for(int col = 0; col < game.getCols(); ++col)
+    {
+        if(game.isWinningMove(col))
+            return 1000 + cells - game.getMoveCount();
+    }
+
+    if(depth <= 0)
+        return evaluate(game);
+    if(depth == 1 && evaluator)
+        return scoreChildren(game);
+
+    int best = -1000000;
+    for(int i = 0; i < cols; ++i)
+    {
+        int col = cols / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+        if(game.isColumnFull(col))
+            continue;
+
+        play(game, col);
+        int score = -negamax(game, depth - 1, -beta, -alpha);
+        undo(game);
+        if(stopped)
+            return 0;
+
+        if(score > best)
+            best = score;
+        if(score > alpha)
+            alpha = score;
+        if(alpha >= beta)
+            break;
+    }
+
+    return best;
+}
+
+// The last ply with the learned evaluator: every child is scored in one call without playing it,
+// giving the same best score as searching each child to depth 0 (no move here wins)
+template<typename Game>
+int BasicSearchPolicy<Game>::scoreChildren(const Game& game) const
+{
+    int cells = game.getRows() * game.getCols();
+    int scores[16];
+    evaluator->evaluateChildren(game, scores);
+
+    typename Game::Bitboard nonLosing = game.getNonLosingMoves();
+    int best = -1000000;
+    for(int col = 0; col < game.getCols(); ++col)
+    {
+        if(game.isColumnFull(col))
+            continue;
+
+        int score = scores[col];
+        if(!(nonLosing & Game::columnMask(col)))
+            score = -(1000 + cells - game.getMoveCount() - 1); // The opponent wins next move
+        else if(game.getMoveCount() + 1 == cells)
+            score = 0; // Fills the board
+
+        if(score > best)
+            best = score;
+    }
+
+    return best;
+}
+
+// The learned score when there are weights, otherwise pieces near the center count for more
+// since they take part in more lines
+template<typename Game>
+int BasicSearchPolicy<Game>::evaluate(const Game& game) const
+{
+    if(evaluator)
+        return evaluator->evaluate(game);
+
+    int center = game.getCols() / 2;
+    int me = game.getCurrentPlayer();
+    int score = 0;
+
+    for(int row = 0; row < game.getRows(); ++row)
+    {
+        for(int col = 0; col < game.getCols(); ++col)
+        {
+            int value = game.getBoardValue(row, col);
+            int weight = center + 1 - abs(col - center);
+            if(value == me)
+                score += weight;
+            else if(value != Game::EMPTY)
+                score -= weight;
+        }
+    }
+
+    return score;
+}
+
+// Moves go through the evaluator when there is one, so its features follow the board
+template<typename Game>
+void BasicSearchPolicy<Game>::play(Game& game, int col) const
+{
+    if(evaluator)
+        evaluator->dropPiece(game, col);
+    else
+        game.dropPiece(col);
+}
+
+template<typename Game>
+void BasicSearchPolicy<Game>::undo(Game& game) const
+{
+    if(evaluator)
+        evaluator->undoMove(game);
+    else
+        game.undoMove();
+}
+
+
+
+// MCTS Policy
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+BasicMCTSPolicy<Game>::BasicMCTSPolicy(int playouts): playouts(playouts)
+{
+}
+
+template<typename Game>
+BasicMCTSPolicy<Game>::~BasicMCTSPolicy() = default;
+
+// The tree is seeded from the game's random stream, so games stay reproducible
+template<typename Game>
+int BasicMCTSPolicy<Game>::chooseMove(const Game& game, Random& random)
+{
+    if(!player)
+        player.reset(new BasicMCTSPlayer<Game>(1, BasicMCTSPlayer<Game>::DEFAULT_CAPACITY, random.next()));
+
+    return player->search(game, 0, playouts);
+}
+
+template<typename Game>
+std::string BasicMCTSPolicy<Game>::getName() const
+{
+    return "mcts:" + std::to_string(playouts);
+}
+
+
+
+// Policy factory
+//----------------------------------------------------------------------------------------//
+
+template<typename Game>
+std::unique_ptr<BasicPolicy<Game>> createPolicy(const std::string& spec)
+{
+    using Pointer = std::unique_ptr<BasicPolicy<Game>>;
+    if(spec == "random")
+        return Pointer(new BasicRandomPolicy<Game>());
+    if(spec == "greedy")
+        return Pointer(new BasicGreedyPolicy<Game>());
+    if(spec.compare(0, 7, "search:") == 0)
+    {
+        int depth = atoi(spec.c_str() + 7);
+        size_t weights = spec.find(':', 7);
+        if(depth > 0 && weights == std::string::npos)
+            return Pointer(new BasicSearchPolicy<Game>(depth));
+        if(depth > 0)
+        {
+            std::unique_ptr<BasicSearchPolicy<Game>> policy(new BasicSearchPolicy<Game>(depth, spec.substr(weights + 1)));
+            if(policy->hasEvaluator())
+                return policy;
+        }
+    }
+    if(spec.compare(0, 5, "mcts:") == 0)
+    {
+        int playouts = atoi(spec.c_str() + 5);
+        if(playouts > 0)
+            return Pointer(new BasicMCTSPolicy<Game>(playouts));
+    }
+
+    return nullptr;
+}
+
+
+
+//----------------------------------------------------------------------------------------//
+// Board sizes in use
+
+template class BasicRandomPolicy<Connect4Game>;
+template class BasicGreedyPolicy<Connect4Game>;
+template class BasicSearchPolicy<Connect4Game>;
+template class BasicMCTSPolicy<Connect4Game>;
+template std::unique_ptr<BasicPolicy<Connect4Game>> createPolicy<Connect4Game>(const std::string& spec);
+template class BasicRandomPolicy<Connect4Game8x7>;
+template class BasicGreedyPolicy<Connect4Game8x7>;
+template class BasicSearchPolicy<Connect4Game8x7>;
+template class BasicMCTSPolicy<Connect4Game8x7>;
+template std::unique_ptr<BasicPolicy<Connect4Game8x7>> createPolicy<Connect4Game8x7>(const std::string& spec);
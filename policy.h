@@ -0,0 +1,134 @@
+// Connect 4
+// Move policies header file
+
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "connect4.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+template<typename Game> class BasicMCTSPlayer;
+template<typename Game> class BasicEvaluator;
+
+// Small fast random number generator (xorshift64*), one per thread
+class Random
+{
+    public:
+        Random(uint64_t seed = 1);
+
+        uint64_t next();
+        int nextInt(int bound); // 0 .. bound - 1
+
+    private:
+        uint64_t state;
+};
+
+// Chooses a move for the current player
+template<typename Game>
+class BasicPolicy
+{
+    public:
+        virtual ~BasicPolicy() = default;
+
+        virtual int chooseMove(const Game& game, Random& random) = 0;
+        virtual std::string getName() const = 0;
+};
+
+// Any legal move
+template<typename Game>
+class BasicRandomPolicy : public BasicPolicy<Game>
+{
+    public:
+        int chooseMove(const Game& game, Random& random) override;
+        std::string getName() const override;
+};
+
+// Wins when it can, blocks immediate threats, otherwise plays a random safe move
+template<typename Game>
+class BasicGreedyPolicy : public BasicPolicy<Game>
+{
+    public:
+        int chooseMove(const Game& game, Random& random) override;
+        std::string getName() const override;
+};
+
+// Depth-limited negamax, the horizon is scored by a learned evaluator when weights are given
+// and by a center-control estimate otherwise. A stop check lets a caller deepen it one ply
+// at a time under a time limit
+template<typename Game>
+class BasicSearchPolicy : public BasicPolicy<Game>
+{
+    public:
+        BasicSearchPolicy(int depth, const std::string& weightsPath = ""); // Weights trained on the same board size
+        ~BasicSearchPolicy();
+
+        int chooseMove(const Game& game, Random& random) override;
+        std::string getName() const override;
+        bool hasEvaluator() const; // False when the weights could not be loaded
+
+        // Setters
+        void setDepth(int depth);
+        void setStop(std::function<bool()> stop); // Asked at every node, true abandons the search
+
+        // Getters
+        bool wasStopped() const; // The last move chosen is meaningless
+        int getScore() const;    // Score of the last move chosen, wins are 1000 and up
+
+    private:
+        int depth;
+        std::string weightsPath;
+        std::unique_ptr<BasicEvaluator<Game>> evaluator;
+        std::function<bool()> stop;
+        bool stopped;
+        int score;
+
+        int negamax(Game& game, int depth, int alpha, int beta);
+        int scoreChildren(const Game& game) const;
+        int evaluate(const Game& game) const;
+        void play(Game& game, int col) const;
+        void undo(Game& game) const;
+};
+
+// Monte Carlo tree search with a fixed number of playouts per move, keeping its tree between moves
+template<typename Game>
+class BasicMCTSPolicy : public BasicPolicy<Game>
+{
+    public:
+        BasicMCTSPolicy(int playouts);
+        ~BasicMCTSPolicy();
+
+        int chooseMove(const Game& game, Random& random) override;
+        std::string getName() const override;
+
+    private:
+        int playouts;
+        std::unique_ptr<BasicMCTSPlayer<Game>> player; // Created on first use
+};
+
+// Build a policy from "random", "greedy", "search:N", "search:N:weights" or "mcts:N",
+// returns nullptr for anything else
+template<typename Game = Connect4Game>
+std::unique_ptr<BasicPolicy<Game>> createPolicy(const std::string& spec);
+
+using Policy = BasicPolicy<Connect4Game>;
+using RandomPolicy = BasicRandomPolicy<Connect4Game>;
+using GreedyPolicy = BasicGreedyPolicy<Connect4Game>;
+using SearchPolicy = BasicSearchPolicy<Connect4Game>;
+using MCTSPolicy = BasicMCTSPolicy<Connect4Game>;
+
+// Compiled once in policy.cpp for the boards the learned evaluator has weights for
+extern template class BasicRandomPolicy<Connect4Game>;
+extern template class BasicGreedyPolicy<Connect4Game>;
+extern template class BasicSearchPolicy<Connect4Game>;
+extern template class BasicMCTSPolicy<Connect4Game>;
+extern template std::unique_ptr<BasicPolicy<Connect4Game>> createPolicy<Connect4Game>(const std::string& spec);
+extern template class BasicRandomPolicy<Connect4Game8x7>;
+extern template class BasicGreedyPolicy<Connect4Game8x7>;
+extern template class BasicSearchPolicy<Connect4Game8x7>;
+extern template class BasicMCTSPolicy<Connect4Game8x7>;
+extern template std::unique_ptr<BasicPolicy<Connect4Game8x7>> createPolicy<Connect4Game8x7>(const std::string& spec);
+
+#endif
@@ -0,0 +1,357 @@
+// Connect 4
+// Contains function implementations for game record files
+
+#include "record.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout, see record.h
+static const uint32_t VERSION = 1;
+static const size_t HEADER_SIZE = 16;
+static const size_t BLOCK_SIZE = 16384;
+static const size_t BLOCK_HEADER_SIZE = 8;
+static const size_t GAME_HEADER_SIZE = 4;
+
+struct FileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint8_t rows, cols, unused[2];
+    uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == HEADER_SIZE, "Record header layout changed");
+
+// Bytes taken by a game with this many moves
+static size_t gameSize(int length)
+{
+    return GAME_HEADER_SIZE + (length * 3 + 7) / 8;
+}
+
+// Write all of a buffer, retrying short writes
+static bool writeAll(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while(size > 0)
+    {
+        ssize_t written = ::write(fd, bytes, size);
+        if(written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+
+
+// GameRecord
+//----------------------------------------------------------------------------------------//
+
+// Moves are packed from the lowest bit of the first byte up
+int GameRecord::getMove(int index) const
+{
+    int bit = index * 3;
+    int value = moves[bit / 8] >> (bit % 8);
+    if(bit % 8 > 5)
+        value |= moves[bit / 8 + 1] << (8 - bit % 8);
+
+    return value & 7;
+}
+
+int GameRecord::getWinner() const
+{
+    return (result == RESULT_DRAW) ? -1 : result;
+}
+
+// Feed the moves through dropPiece(), checking each is legal and, for a
+// whole game, that it ends the way the record says
+bool GameRecord::replay(Connect4Game& game, int moveCount) const
+{
+    bool whole = moveCount < 0 || moveCount >= length;
+    int count = whole ? length : moveCount;
+
+    game.resetGame();
+    for(int i = 0; i < count; ++i)
+    {
+        if(game.isGameOver() || !game.dropPiece(getMove(i)))
+            return false;
+    }
+
+    return !whole || game.getWinner() == getWinner();
+}
+
+
+
+// RecordWriter
+//----------------------------------------------------------------------------------------//
+
+RecordWriter::RecordWriter(): fd(-1), block(BLOCK_SIZE), used(BLOCK_HEADER_SIZE), games(0), totalGames(0)
+{
+}
+
+RecordWriter::~RecordWriter()
+{
+    close();
+}
+
+// Create the file, or check an existing one is for the same board and append to it
+bool RecordWriter::open(const std::string& path, int rows, int cols)
+{
+    close();
+    if(cols > 8 || rows * cols > 255)
+        return false; // Moves are packed into 3 bits, lengths into one byte
+
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if(file < 0)
+        return false;
+
+    FileHeader header = {};
+    ssize_t size = ::read(file, &header, sizeof(header));
+    if(size == 0)
+    {
+        memcpy(header.magic, "C4GR", 4);
+        header.version = VERSION;
+        header.rows = rows;
+        header.cols = cols;
+        if(!writeAll(file, &header, sizeof(header)))
+        {
+            ::close(file);
+            return false;
+        }
+    }
+    else if(size != sizeof(header) || memcmp(header.magic, "C4GR", 4) != 0 || header.version != VERSION ||
+            header.rows != rows || header.cols != cols)
+    {
+        ::close(file);
+        return false;
+    }
+
+    fd = file;
+    return true;
+}
+
+// Write out the current block, padded to full size so blocks stay at fixed offsets
+bool RecordWriter::flush()
+{
+    if(fd < 0)
+        return false;
+    if(games == 0)
+        return true;
+
+    memcpy(block.data(), &games, 4);
+    memcpy(block.data() + 4, &used, 4);
+    memset(block.data() + used, 0, BLOCK_SIZE - used);
+
+    // One append per block, so writers sharing the file never split each other's blocks
+    bool written = writeAll(fd, block.data(), BLOCK_SIZE);
+    used = BLOCK_HEADER_SIZE;
+    games = 0;
+
+    return written;
+}
+
+bool RecordWriter::close()
+{
+    if(fd < 0)
+        return true;
+
+    bool flushed = flush();
+    ::close(fd);
+    fd = -1;
+
+    return flushed;
+}
+
+// Pack one game's moves at 3 bits each, winner as Connect4Game reports it
+bool RecordWriter::addMoves(const uint8_t* moves, int length, int winner, int engine1, int engine2)
+{
+    if(fd < 0)
+        return false;
+
+    size_t size = gameSize(length);
+    if(used + size > BLOCK_SIZE && !flush())
+        return false;
+
+    uint8_t* data = block.data() + used;
+    data[0] = (winner == -1) ? GameRecord::RESULT_DRAW : winner;
+    data[1] = length;
+    data[2] = engine1;
+    data[3] = engine2;
+
+    uint8_t* packed = data + GAME_HEADER_SIZE;
+    memset(packed, 0, size - GAME_HEADER_SIZE);
+    for(int i = 0; i < length; ++i)
+    {
+        int bit = i * 3;
+        int move = moves[i];
+        packed[bit / 8] |= move << (bit % 8);
+        if(bit % 8 > 5)
+            packed[bit / 8 + 1] |= move >> (8 - bit % 8);
+    }
+
+    used += size;
+    ++games;
+    ++totalGames;
+
+    return true;
+}
+
+bool RecordWriter::isOpen() const
+{
+    return fd >= 0;
+}
+
+unsigned long long RecordWriter::getGameCount() const
+{
+    return totalGames;
+}
+
+
+
+// RecordReader
+//----------------------------------------------------------------------------------------//
+
+RecordReader::RecordReader(): mapping(nullptr), mappingSize(0), blocks(nullptr), blockCount(0), rows(0), cols(0)
+{
+}
+
+RecordReader::~RecordReader()
+{
+    close();
+}
+
+// Map a record file into memory, returns false if it is missing or not a valid record file
+bool RecordReader::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_SIZE ||
+       (info.st_size - HEADER_SIZE) % BLOCK_SIZE != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // The mapping stays valid after the file is closed
+    if(data == MAP_FAILED)
+        return false;
+
+    const FileHeader* header = static_cast<const FileHeader*>(data);
+    if(memcmp(header->magic, "C4GR", 4) != 0 || header->version != VERSION)
+    {
+        munmap(data, info.st_size);
+        return false;
+    }
+
+    // Whole file is read front to back
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    mapping = data;
+    mappingSize = info.st_size;
+    blocks = static_cast<const uint8_t*>(data) + HEADER_SIZE;
+    blockCount = (info.st_size - HEADER_SIZE) / BLOCK_SIZE;
+    rows = header->rows;
+    cols = header->cols;
+
+    return true;
+}
+
+// Unmap the file
+void RecordReader::close()
+{
+    if(mapping)
+        munmap(mapping, mappingSize);
+
+    mapping = nullptr;
+    mappingSize = 0;
+    blocks = nullptr;
+    blockCount = 0;
+    rows = 0;
+    cols = 0;
+}
+
+// Walk blocks [firstBlock, endBlock), give each thread its own range to scan in parallel
+RecordCursor RecordReader::cursor(size_t firstBlock, size_t endBlock) const
+{
+    if(endBlock > blockCount)
+        endBlock = blockCount;
+
+    return RecordCursor{firstBlock, endBlock, BLOCK_HEADER_SIZE};
+}
+
+// Step to the next game, false at the end of the range
+bool RecordReader::next(RecordCursor& cursor, GameRecord& record) const
+{
+    while(cursor.block < cursor.endBlock)
+    {
+        const uint8_t* block = blocks + cursor.block * BLOCK_SIZE;
+        uint32_t used;
+        memcpy(&used, block + 4, 4);
+        if(used > BLOCK_SIZE)
+            used = BLOCK_SIZE;
+
+        if(cursor.offset + GAME_HEADER_SIZE <= used)
+        {
+            const uint8_t* game = block + cursor.offset;
+            size_t size = gameSize(game[1]);
+            if(cursor.offset + size <= used)
+            {
+                record.result = game[0];
+                record.length = game[1];
+                record.engine1 = game[2];
+                record.engine2 = game[3];
+                record.moves = game + GAME_HEADER_SIZE;
+                cursor.offset += size;
+                return true;
+            }
+        }
+
+        ++cursor.block;
+        cursor.offset = BLOCK_HEADER_SIZE;
+    }
+
+    return false;
+}
+
+bool RecordReader::isOpen() const
+{
+    return mapping != nullptr;
+}
+
+int RecordReader::getRows() const
+{
+    return rows;
+}
+
+int RecordReader::getCols() const
+{
+    return cols;
+}
+
+size_t RecordReader::getBlockCount() const
+{
+    return blockCount;
+}
+
+unsigned long long RecordReader::getGameCount() const
+{
+    unsigned long long count = 0;
+    for(size_t i = 0; i < blockCount; ++i)
+    {
+        uint32_t games;
+        memcpy(&games, blocks + i * BLOCK_SIZE, 4);
+        count += games;
+    }
+
+    return count;
+}
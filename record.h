@@ -0,0 +1,123 @@
+// Connect 4
+// Game record file header file
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "connect4.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Record file layout (native byte order):
+  header  "C4GR", version, rows, cols
+  blocks  BLOCK_SIZE bytes each: game count, bytes used, then whole games
+
+Each game is 4 bytes (result, length, player 1 engine id, player 2 engine id)
+followed by its moves at 3 bits each, so boards may have at most 8 columns.
+Games never cross a block, which lets several threads each take a range of
+blocks, and writers only ever append whole blocks, so many writers can share
+one file. Engine ids are chosen by whoever writes the file.
+*/
+
+// One recorded game, pointing straight into the mapped file
+struct GameRecord
+{
+    static const int RESULT_NONE = 0;  // Game stopped before it ended
+    static const int RESULT_DRAW = 3;  // 1 and 2 are wins for that player
+
+    int result;
+    int length;
+    int engine1, engine2;
+    const uint8_t* moves;
+
+    int getMove(int index) const;
+    int getWinner() const; // Same values as Connect4Game::getWinner()
+    bool replay(Connect4Game& game, int moveCount = -1) const; // Play the moves, false if the record is wrong
+};
+
+// Block range and position of a walk through a record file
+struct RecordCursor
+{
+    size_t block;
+    size_t endBlock;
+    uint32_t offset; // Next game inside the block
+};
+
+// Appends games to a record file through a one block buffer
+class RecordWriter
+{
+    public:
+        RecordWriter();
+        ~RecordWriter();
+        RecordWriter(const RecordWriter&) = delete;
+        RecordWriter& operator=(const RecordWriter&) = delete;
+
+        // File handling
+        bool open(const std::string& path, int rows, int cols); // Appends if the file exists
+        bool flush();                                           // Write the buffered block out
+        bool close();
+
+        // Recording
+        template<typename Game> bool add(const Game& game, int engine1, int engine2); // Any board size the file holds
+
+        // Getters
+        bool isOpen() const;
+        unsigned long long getGameCount() const; // Games added by this writer
+
+    private:
+        int fd;
+        std::vector<uint8_t> block;
+        uint32_t used;
+        uint32_t games;
+        unsigned long long totalGames;
+
+        bool addMoves(const uint8_t* moves, int length, int winner, int engine1, int engine2);
+};
+
+template<typename Game>
+bool RecordWriter::add(const Game& game, int engine1, int engine2)
+{
+    uint8_t moves[Game::ROWS * Game::COLS];
+    int length = game.getMoveCount();
+    for(int i = 0; i < length; ++i)
+        moves[i] = game.getMove(i);
+
+    return addMoves(moves, length, game.getWinner(), engine1, engine2);
+}
+
+// Read-only memory mapped view of a record file
+class RecordReader
+{
+    public:
+        RecordReader();
+        ~RecordReader();
+        RecordReader(const RecordReader&) = delete;
+        RecordReader& operator=(const RecordReader&) = delete;
+
+        // File handling
+        bool open(const std::string& path);
+        void close();
+
+        // Iteration
+        RecordCursor cursor(size_t firstBlock = 0, size_t endBlock = SIZE_MAX) const;
+        bool next(RecordCursor& cursor, GameRecord& record) const;
+
+        // Getters
+        bool isOpen() const;
+        int getRows() const;
+        int getCols() const;
+        size_t getBlockCount() const;
+        unsigned long long getGameCount() const; // Reads every block header
+
+    private:
+        void* mapping;
+        size_t mappingSize;
+        const uint8_t* blocks;
+        size_t blockCount;
+        int rows, cols;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// Connect 4
+// Replays a game record file through Connect4Game to verify it
+//
+// Usage: replay [-g N] file
+//   -g N   print game N (from 0) as a move string instead of verifying
+//
+// Move strings use columns numbered from 1, the same as the solve tool.
+
+#include "record.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using std::cout, std::cerr, std::endl;
+
+int main(int argc, char* argv[])
+{
+    long long printGame = -1;
+    std::string path;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            printGame = atoll(argv[++i]);
+        else if(path.empty() && argv[i][0] != '-')
+            path = argv[i];
+        else
+        {
+            path.clear();
+            break;
+        }
+    }
+    if(path.empty())
+    {
+        cerr << "Usage: " << argv[0] << " [-g N] file" << endl;
+        return 1;
+    }
+
+    RecordReader reader;
+    if(!reader.open(path))
+    {
+        cerr << "Can't read record file " << path << endl;
+        return 1;
+    }
+    if(reader.getRows() != Connect4Game::ROWS || reader.getCols() != Connect4Game::COLS)
+    {
+        cerr << "Record is for a " << reader.getCols() << "x" << reader.getRows() << " board" << endl;
+        return 1;
+    }
+
+    RecordCursor cursor = reader.cursor();
+    GameRecord record;
+
+    // Print one game
+    if(printGame >= 0)
+    {
+        for(long long i = 0; reader.next(cursor, record); ++i)
+        {
+            if(i != printGame)
+                continue;
+
+            std::string moves;
+            for(int m = 0; m < record.length; ++m)
+                moves += static_cast<char>('1' + record.getMove(m));
+            cout << moves << endl;
+            return 0;
+        }
+
+        cerr << "No game " << printGame << endl;
+        return 1;
+    }
+
+    // Verify every game
+    auto start = std::chrono::steady_clock::now();
+    Connect4Game game;
+    unsigned long long games = 0, moves = 0, invalid = 0;
+    unsigned long long results[4] = {};
+
+    while(reader.next(cursor, record))
+    {
+        ++games;
+        moves += record.length;
+        if(!record.replay(game))
+        {
+            if(invalid == 0)
+                cerr << "Game " << games - 1 << " does not replay" << endl;
+            ++invalid;
+        }
+        ++results[record.result & 3];
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count() > 0 ? elapsed.count() : 1e-9;
+
+    cout << "Games:          " << games << endl;
+    cout << "Moves:          " << moves << endl;
+    cout << "Player 1 wins:  " << results[1] << endl;
+    cout << "Player 2 wins:  " << results[2] << endl;
+    cout << "Draws:          " << results[GameRecord::RESULT_DRAW] << endl;
+    cout << "Unfinished:     " << results[GameRecord::RESULT_NONE] << endl;
+    cout << "Invalid:        " << invalid << endl;
+    cout << "Time:           " << elapsed.count() << " s" << endl;
+    cout << "Moves/sec:      " << static_cast<long long>(moves / seconds) << endl;
+
+    return invalid ? 2 : 0;
+}
@@ -0,0 +1,445 @@
+// Connect 4
+// Analytics scanner: aggregate statistics over record files on every core
+//
+// The files are memory mapped and cut into chunks of blocks, which workers
+// take from a shared counter. Games are read in place and replayed on bare
+// bitboards (Connect4Game's fast path), each worker fills its own
+// histograms and they are added up at the end. Reported:
+//   openings      results of the games starting with each sequence of -d moves
+//   first wins    the ply where the side to move first had a winning move, and
+//                 how often it was played right away
+//   win columns   the column of each game's winning move
+//   engines       games, average length and results of each engine id
+// Games that don't replay to their recorded result are counted as invalid and
+// left out of everything else.
+//
+// Usage: scan [options] records...
+//   -t N                 worker threads (default: all hardware threads)
+//   -c N                 blocks per chunk (default 64)
+//   -d N                 opening length in plies, 0 to 4 (default 2)
+//   --format json|csv    output format (default json)
+//   -o path              write the report to a file instead of stdout
+
+#include "connect4.h"
+#include "record.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using std::cout, std::cerr, std::endl;
+
+const int MAX_ENGINES = 256; // Engine ids are one byte
+const int MAX_PLIES = 64;
+
+struct ScanOptions
+{
+    int threads = std::thread::hardware_concurrency();
+    size_t chunkBlocks = 64;
+    int openingPlies = 2;
+    std::string format = "json";
+    std::string outputPath;
+};
+
+// Results of a group of games
+struct OutcomeCounts
+{
+    unsigned long long games = 0;
+    unsigned long long player1Wins = 0;
+    unsigned long long player2Wins = 0;
+    unsigned long long draws = 0;
+    unsigned long long unfinished = 0;
+
+    void add(int winner)
+    {
+        ++games;
+        if(winner == 1)
+            ++player1Wins;
+        else if(winner == 2)
+            ++player2Wins;
+        else if(winner == -1)
+            ++draws;
+        else
+            ++unfinished;
+    }
+
+    OutcomeCounts& operator+=(const OutcomeCounts& other)
+    {
+        games += other.games;
+        player1Wins += other.player1Wins;
+        player2Wins += other.player2Wins;
+        draws += other.draws;
+        unfinished += other.unfinished;
+        return *this;
+    }
+};
+
+// One engine's games, from its own side of the board
+struct EngineCounts
+{
+    unsigned long long games = 0;
+    unsigned long long moves = 0; // Game lengths added up
+    unsigned long long wins = 0;
+    unsigned long long draws = 0;
+    unsigned long long losses = 0;
+};
+
+// Histograms of one worker, merged into one at the end
+struct ScanStats
+{
+    unsigned long long games = 0;
+    unsigned long long moves = 0;
+    unsigned long long invalid = 0;
+    std::vector<OutcomeCounts> openings;
+    unsigned long long winAvailable[MAX_PLIES] = {};
+    unsigned long long winTaken[MAX_PLIES] = {};
+    unsigned long long winColumns[8] = {};
+    EngineCounts engines[MAX_ENGINES];
+
+    void merge(const ScanStats& other)
+    {
+        games += other.games;
+        moves += other.moves;
+        invalid += other.invalid;
+        for(size_t i = 0; i < openings.size(); ++i)
+            openings[i] += other.openings[i];
+        for(int ply = 0; ply < MAX_PLIES; ++ply)
+        {
+            winAvailable[ply] += other.winAvailable[ply];
+            winTaken[ply] += other.winTaken[ply];
+        }
+        for(int col = 0; col < 8; ++col)
+            winColumns[col] += other.winColumns[col];
+        for(int id = 0; id < MAX_ENGINES; ++id)
+        {
+            engines[id].games += other.engines[id].games;
+            engines[id].moves += other.engines[id].moves;
+            engines[id].wins += other.engines[id].wins;
+            engines[id].draws += other.engines[id].draws;
+            engines[id].losses += other.engines[id].losses;
+        }
+    }
+};
+
+// A range of blocks in one file
+struct ScanChunk
+{
+    const RecordReader* reader;
+    size_t firstBlock;
+    size_t endBlock;
+};
+
+// Replay one game and add it to the histograms
+template<typename Game>
+void scanGame(const GameRecord& record, int openingPlies, ScanStats& stats)
+{
+    using Bitboard = typename Game::Bitboard;
+    Bitboard pieces[2] = {0, 0};
+    Bitboard occupied = 0;
+    int winner = 0;
+    int firstWin = -1;
+    int opening = 0;
+
+    for(int ply = 0; ply < record.length; ++ply)
+    {
+        int col = record.getMove(ply);
+        int side = ply & 1;
+        if(winner || col >= Game::COLS)
+        {
+            ++stats.invalid; // Moves after the end, or off the board
+            return;
+        }
+        if(ply < openingPlies)
+            opening = opening * Game::COLS + col;
+
+        // Lines need CONNECT - 1 pieces of the side to move before it can have a winning move
+        bool canLine = ply / 2 >= Game::CONNECT - 1;
+        if(canLine && firstWin < 0 && Game::threatCells(pieces[side], occupied))
+            firstWin = ply;
+
+        Bitboard cell = Game::dropCell(occupied, col);
+        if(!cell)
+        {
+            ++stats.invalid;
+            return;
+        }
+        pieces[side] |= cell;
+        occupied |= cell;
+
+        if(canLine && Game::hasLine(pieces[side]))
+            winner = side + 1;
+    }
+    if(!winner && occupied == Game::boardMask())
+        winner = -1;
+
+    if(winner != record.getWinner() || record.length >= MAX_PLIES)
+    {
+        ++stats.invalid;
+        return;
+    }
+
+    ++stats.games;
+    stats.moves += record.length;
+    if(record.length >= openingPlies)
+        stats.openings[opening].add(winner);
+
+    if(firstWin >= 0)
+    {
+        ++stats.winAvailable[firstWin];
+        if(winner > 0 && firstWin == record.length - 1)
+            ++stats.winTaken[firstWin];
+    }
+    if(winner > 0)
+        ++stats.winColumns[record.getMove(record.length - 1)];
+
+    // Each engine scored from its own side
+    int ids[2] = {record.engine1, record.engine2};
+    for(int side = 0; side < 2; ++side)
+    {
+        EngineCounts& engine = stats.engines[ids[side]];
+        ++engine.games;
+        engine.moves += record.length;
+        if(winner == -1)
+            ++engine.draws;
+        else if(winner == side + 1)
+            ++engine.wins;
+        else if(winner > 0)
+            ++engine.losses;
+    }
+}
+
+// Move string of an opening index, columns from 1
+std::string openingMoves(int index, int plies, int cols)
+{
+    std::string moves(plies, '1');
+    for(int i = plies - 1; i >= 0; --i)
+    {
+        moves[i] = static_cast<char>('1' + index % cols);
+        index /= cols;
+    }
+    return moves;
+}
+
+void writeJSON(std::ostream& out, const ScanStats& stats, const ScanOptions& options, int cols, size_t files,
+               double seconds)
+{
+    out << "{\n  \"files\": " << files << ",\n  \"games\": " << stats.games << ",\n  \"moves\": " << stats.moves
+        << ",\n  \"invalid\": " << stats.invalid << ",\n  \"seconds\": " << seconds
+        << ",\n  \"games_per_minute\": " << static_cast<long long>((stats.games + stats.invalid) * 60.0 / seconds)
+        << ",\n  \"openings\": [";
+    const char* separator = "\n";
+    for(size_t i = 0; i < stats.openings.size(); ++i)
+    {
+        const OutcomeCounts& o = stats.openings[i];
+        if(o.games == 0)
+            continue;
+        out << separator << "    {\"moves\": \"" << openingMoves(i, options.openingPlies, cols) << "\", \"games\": "
+            << o.games << ", \"player1_wins\": " << o.player1Wins << ", \"player2_wins\": " << o.player2Wins
+            << ", \"draws\": " << o.draws << ", \"unfinished\": " << o.unfinished << "}";
+        separator = ",\n";
+    }
+
+    out << "\n  ],\n  \"first_wins\": [";
+    separator = "\n";
+    for(int ply = 0; ply < MAX_PLIES; ++ply)
+    {
+        if(stats.winAvailable[ply] == 0)
+            continue;
+        out << separator << "    {\"ply\": " << ply + 1 << ", \"games\": " << stats.winAvailable[ply]
+            << ", \"taken\": " << stats.winTaken[ply] << "}";
+        separator = ",\n";
+    }
+
+    out << "\n  ],\n  \"win_columns\": [";
+    for(int col = 0; col < cols; ++col)
+        out << (col ? ", " : "") << stats.winColumns[col];
+
+    out << "],\n  \"engines\": [";
+    separator = "\n";
+    for(int id = 0; id < MAX_ENGINES; ++id)
+    {
+        const EngineCounts& e = stats.engines[id];
+        if(e.games == 0)
+            continue;
+        out << separator << "    {\"id\": " << id << ", \"games\": " << e.games << ", \"average_length\": "
+            << static_cast<double>(e.moves) / e.games << ", \"wins\": " << e.wins << ", \"draws\": " << e.draws
+            << ", \"losses\": " << e.losses << "}";
+        separator = ",\n";
+    }
+    out << "\n  ]\n}" << endl;
+}
+
+// One table after another, each with its own header row and a blank line between them
+void writeCSV(std::ostream& out, const ScanStats& stats, const ScanOptions& options, int cols)
+{
+    out << "opening,games,player1_wins,player2_wins,draws,unfinished" << endl;
+    for(size_t i = 0; i < stats.openings.size(); ++i)
+    {
+        const OutcomeCounts& o = stats.openings[i];
+        if(o.games)
+            out << openingMoves(i, options.openingPlies, cols) << "," << o.games << "," << o.player1Wins << ","
+                << o.player2Wins << "," << o.draws << "," << o.unfinished << endl;
+    }
+
+    out << "\nfirst_win_ply,games,taken" << endl;
+    for(int ply = 0; ply < MAX_PLIES; ++ply)
+    {
+        if(stats.winAvailable[ply])
+            out << ply + 1 << "," << stats.winAvailable[ply] << "," << stats.winTaken[ply] << endl;
+    }
+
+    out << "\nwin_column,games" << endl;
+    for(int col = 0; col < cols; ++col)
+        out << col + 1 << "," << stats.winColumns[col] << endl;
+
+    out << "\nengine,games,average_length,wins,draws,losses" << endl;
+    for(int id = 0; id < MAX_ENGINES; ++id)
+    {
+        const EngineCounts& e = stats.engines[id];
+        if(e.games)
+            out << id << "," << e.games << "," << static_cast<double>(e.moves) / e.games << "," << e.wins << ","
+                << e.draws << "," << e.losses << endl;
+    }
+}
+
+template<typename Game>
+int scan(const std::vector<std::unique_ptr<RecordReader>>& readers, const ScanOptions& options)
+{
+    std::vector<ScanChunk> chunks;
+    for(const std::unique_ptr<RecordReader>& reader : readers)
+    {
+        for(size_t block = 0; block < reader->getBlockCount(); block += options.chunkBlocks)
+            chunks.push_back(ScanChunk{reader.get(), block, block + options.chunkBlocks});
+    }
+
+    int openingCount = 1;
+    for(int i = 0; i < options.openingPlies; ++i)
+        openingCount *= Game::COLS;
+
+    std::vector<std::unique_ptr<ScanStats>> workerStats;
+    for(int i = 0; i < options.threads; ++i)
+    {
+        workerStats.emplace_back(new ScanStats());
+        workerStats.back()->openings.resize(openingCount);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&](int id)
+    {
+        ScanStats& stats = *workerStats[id];
+        GameRecord record;
+        for(size_t c = nextChunk++; c < chunks.size(); c = nextChunk++)
+        {
+            const ScanChunk& chunk = chunks[c];
+            RecordCursor cursor = chunk.reader->cursor(chunk.firstBlock, chunk.endBlock);
+            while(chunk.reader->next(cursor, record))
+                scanGame<Game>(record, options.openingPlies, stats);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 1; i < options.threads; ++i)
+        workers.emplace_back(worker, i);
+    worker(0);
+    for(std::thread& w : workers)
+        w.join();
+
+    for(int i = 1; i < options.threads; ++i)
+        workerStats[0]->merge(*workerStats[i]);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count() > 0 ? elapsed.count() : 1e-9;
+    const ScanStats& stats = *workerStats[0];
+
+    std::ofstream file;
+    if(!options.outputPath.empty())
+    {
+        file.open(options.outputPath);
+        if(!file)
+        {
+            cerr << "Can't write " << options.outputPath << endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? cout : file;
+
+    if(options.format == "csv")
+        writeCSV(out, stats, options, Game::COLS);
+    else
+        writeJSON(out, stats, options, Game::COLS, readers.size(), seconds);
+
+    cerr << stats.games + stats.invalid << " games in " << seconds << " s, "
+         << static_cast<long long>((stats.games + stats.invalid) * 60.0 / seconds) << " games/minute" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    ScanOptions options;
+    std::vector<std::string> paths;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            options.chunkBlocks = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            options.openingPlies = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            options.format = argv[++i];
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            options.outputPath = argv[++i];
+        else if(argv[i][0] != '-')
+            paths.push_back(argv[i]);
+        else
+        {
+            paths.clear();
+            break;
+        }
+    }
+    if(paths.empty() || options.openingPlies < 0 || options.openingPlies > 4 ||
+       (options.format != "json" && options.format != "csv"))
+    {
+        cerr << "Usage: " << argv[0] << " [-t threads] [-c blocks] [-d plies] [--format json|csv] [-o path] records..."
+             << endl;
+        return 1;
+    }
+    if(options.threads < 1)
+        options.threads = 1;
+    if(options.chunkBlocks < 1)
+        options.chunkBlocks = 1;
+
+    // Every file must be for the same board
+    std::vector<std::unique_ptr<RecordReader>> readers;
+    for(const std::string& path : paths)
+    {
+        readers.emplace_back(new RecordReader());
+        if(!readers.back()->open(path))
+        {
+            cerr << "Can't read record file " << path << endl;
+            return 1;
+        }
+        if(readers.back()->getRows() != readers[0]->getRows() || readers.back()->getCols() != readers[0]->getCols())
+        {
+            cerr << path << " is for a different board size" << endl;
+            return 1;
+        }
+    }
+
+    int rows = readers[0]->getRows();
+    int cols = readers[0]->getCols();
+    if(rows == Connect4Game::ROWS && cols == Connect4Game::COLS)
+        return scan<Connect4Game>(readers, options);
+    if(rows == Connect4Game8x7::ROWS && cols == Connect4Game8x7::COLS)
+        return scan<Connect4Game8x7>(readers, options);
+
+    cerr << "No scanner for a " << cols << "x" << rows << " board" << endl;
+    return 1;
+}
@@ -0,0 +1,351 @@
+// Connect 4
+// Analysis server: solves a stream of positions on a pool of workers
+//
+// Each request is one line "id moves", where id is any word chosen by the
+// client and moves are the columns played so far numbered from 1 ("-" or
+// nothing for the empty board). Each reply is one line tagged with its id:
+//   id score bestColumn nodes microseconds
+//   id error invalid position
+// Requests are queued as they arrive and workers take them in batches, so
+// replies come back in the order they finish, not the order they were sent.
+// All workers share one transposition table that stays warm between requests.
+//
+// Options:
+//   -s path    listen on a Unix domain socket instead of stdin/stdout
+//   -t N       worker threads (default: all hardware threads)
+//   -b path    opening book to consult before searching
+//   -e path    endgame table the search stops at
+//   -m MB      transposition table size (default 64, at least 8 so keys stay exact)
+//   -w path    warm start: load the table from this snapshot if there is one and
+//              save it back every 5 minutes, at the end of input and on SIGINT/SIGTERM
+//   -W N       seconds between snapshots (default 300)
+//   -p path    rewrite a JSON snapshot of the performance counters every second
+
+#include "perf.h"
+#include "solver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using std::cout, std::cerr, std::endl;
+
+const size_t BATCH_SIZE = 16;      // Most requests a worker takes from the queue at once
+const size_t MAX_LINE_LENGTH = 1024;
+
+// One client: stdin/stdout or a socket, closed once the client and every reply are done
+struct Connection
+{
+    int inFd, outFd;
+    bool ownsFd;
+    std::mutex writeLock; // Workers reply from several threads
+
+    Connection(int in, int out, bool owns): inFd(in), outFd(out), ownsFd(owns) {}
+    ~Connection()
+    {
+        if(ownsFd)
+            close(inFd);
+    }
+
+    // Send one whole line, lines from different workers never interleave
+    void reply(const std::string& line)
+    {
+        std::lock_guard<std::mutex> guard(writeLock);
+        const char* data = line.data();
+        size_t size = line.size();
+        while(size > 0)
+        {
+            ssize_t written = write(outFd, data, size);
+            if(written <= 0)
+                return; // Client went away
+            data += written;
+            size -= written;
+        }
+    }
+};
+
+struct Request
+{
+    std::string id;
+    std::string moves;
+    std::shared_ptr<Connection> client;
+};
+
+// Requests waiting for a worker
+struct RequestQueue
+{
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<Request> requests;
+    bool closed = false;
+    size_t workerCount = 1;
+};
+
+// Solve requests in batches until the queue is closed and empty
+void runWorker(RequestQueue& queue, TranspositionTable& table, const OpeningBook* book, const OpeningBook* endgame)
+{
+    Connect4Solver solver(&table);
+    solver.setBook(book);
+    solver.setEndgameTable(endgame);
+    std::vector<Request> batch;
+
+    while(true)
+    {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> guard(queue.lock);
+            queue.ready.wait(guard, [&]() { return !queue.requests.empty() || queue.closed; });
+            if(queue.requests.empty())
+                return;
+
+            // Leave every worker its share of a burst instead of draining it on one thread
+            size_t share = std::min(BATCH_SIZE, std::max<size_t>(1, queue.requests.size() / queue.workerCount));
+            while(!queue.requests.empty() && batch.size() < share)
+            {
+                batch.push_back(std::move(queue.requests.front()));
+                queue.requests.pop_front();
+            }
+        }
+
+        for(Request& request : batch)
+        {
+            Connect4Game game;
+            std::string moves = (request.moves == "-") ? "" : request.moves;
+            if(!game.playSequence(moves) || game.isGameOver())
+            {
+                request.client->reply(request.id + " error invalid position\n");
+                continue;
+            }
+
+            SolverResult result = solver.solve(game);
+            std::ostringstream line;
+            line << request.id << " " << result.score << " " << result.bestMove + 1 << " " << result.nodeCount
+                 << " " << static_cast<long long>(result.seconds * 1e6) << "\n";
+            request.client->reply(line.str());
+        }
+    }
+}
+
+// Queue every request line from a client until it closes its side
+void readRequests(std::shared_ptr<Connection> client, RequestQueue& queue)
+{
+    std::string pending;
+    char buffer[4096];
+
+    while(true)
+    {
+        ssize_t size = read(client->inFd, buffer, sizeof(buffer));
+        if(size <= 0)
+            break;
+        pending.append(buffer, size);
+
+        size_t start = 0;
+        size_t end;
+        while((end = pending.find('\n', start)) != std::string::npos)
+        {
+            std::istringstream fields(pending.substr(start, end - start));
+            start = end + 1;
+
+            Request request;
+            if(!(fields >> request.id))
+                continue; // Blank line
+            fields >> request.moves;
+            request.client = client;
+
+            {
+                std::lock_guard<std::mutex> guard(queue.lock);
+                queue.requests.push_back(std::move(request));
+            }
+            queue.ready.notify_one();
+        }
+        pending.erase(0, start);
+
+        if(pending.size() > MAX_LINE_LENGTH)
+            pending.clear(); // Not a request, drop it
+    }
+}
+
+// Listening socket bound to a Unix domain socket path, -1 on failure
+int openSocket(const std::string& path)
+{
+    sockaddr_un address = {};
+    if(path.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Socket path too long: " << path << endl;
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if(listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+       listen(listener, 64) != 0)
+    {
+        cerr << "Can't listen on " << path << endl;
+        if(listener >= 0)
+            close(listener);
+        return -1;
+    }
+
+    return listener;
+}
+
+// Accept clients forever, each gets its own reader thread
+void serveSocket(int listener, RequestQueue& queue)
+{
+    while(true)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if(fd < 0)
+            continue;
+
+        std::thread(readRequests, std::make_shared<Connection>(fd, fd, true), std::ref(queue)).detach();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string socketPath;
+    int threads = std::thread::hardware_concurrency();
+    OpeningBook book;
+    OpeningBook endgame;
+    size_t tableMB = TranspositionTable::DEFAULT_MB;
+    std::string snapshotPath;
+    int snapshotInterval = 300;
+    std::unique_ptr<PerfReporter> perfReporter;
+
+    // Blocked before any thread starts so every thread inherits it, the signal
+    // thread waits for them when there is a snapshot to save
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            socketPath = argv[++i];
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            if(!book.open(argv[++i]))
+            {
+                cerr << "Could not open book " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            if(!endgame.open(argv[++i]))
+            {
+                cerr << "Could not open endgame table " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            tableMB = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            snapshotPath = argv[++i];
+        else if(strcmp(argv[i], "-W") == 0 && i + 1 < argc)
+            snapshotInterval = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            perfReporter.reset(new PerfReporter(argv[++i]));
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-s socket] [-t threads] [-b book] [-e endgame] [-m MB] [-w snapshot] [-W seconds] [-p perf.json]" << endl;
+            return 1;
+        }
+    }
+    if(threads < 1)
+        threads = 1;
+
+    signal(SIGPIPE, SIG_IGN); // A client leaving early must not kill the server
+
+    // Bound before any worker starts, so a bad path fails cleanly
+    int listener = -1;
+    if(!socketPath.empty() && (listener = openSocket(socketPath)) < 0)
+        return 1;
+
+    TranspositionTable table(tableMB);
+    std::unique_ptr<TableSnapshotter> snapshotter;
+    std::thread signalThread;
+    std::atomic<bool> shuttingDown(false);
+    if(!snapshotPath.empty())
+    {
+        auto start = std::chrono::steady_clock::now();
+        if(table.load(snapshotPath, Connect4Game::ROWS, Connect4Game::COLS))
+        {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            cerr << "Loaded " << table.getSize() << " table entries from " << snapshotPath << " in "
+                 << elapsed.count() << " ms" << endl;
+        }
+        snapshotter.reset(new TableSnapshotter(table, snapshotPath, Connect4Game::ROWS, Connect4Game::COLS,
+                                               snapshotInterval));
+
+        // SIGINT and SIGTERM save a last snapshot and exit, main wakes the thread
+        // the same way to stop it before the snapshotter goes out of scope
+        TableSnapshotter* saver = snapshotter.get();
+        signalThread = std::thread([stopSignals, saver, &shuttingDown]()
+        {
+            int received;
+            sigwait(&stopSignals, &received);
+            if(shuttingDown.load())
+                return;
+            saver->save();
+            _exit(0);
+        });
+    }
+    else
+        pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+
+    RequestQueue queue;
+    queue.workerCount = threads;
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i)
+        workers.emplace_back(runWorker, std::ref(queue), std::ref(table), book.isOpen() ? &book : nullptr,
+                             endgame.isOpen() ? &endgame : nullptr);
+
+    if(listener >= 0)
+        serveSocket(listener, queue);
+    else
+        readRequests(std::make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO, false), queue);
+
+    // Input ended, finish what is queued
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.closed = true;
+    }
+    queue.ready.notify_all();
+    for(std::thread& worker : workers)
+        worker.join();
+
+    // A signal from here on stays pending, the snapshotter saves once more when it is destroyed
+    if(signalThread.joinable())
+    {
+        shuttingDown.store(true);
+        pthread_kill(signalThread.native_handle(), SIGTERM);
+        signalThread.join();
+    }
+
+    TableStats stats = table.getStats();
+    cerr << "Table hit rate " << 100.0 * stats.getHitRate() << "%, eviction rate "
+         << 100.0 * stats.getEvictionRate() << "%" << endl;
+
+    return 0;
+}
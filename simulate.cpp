@@ -0,0 +1,170 @@
+// Connect 4
+// Headless self-play simulator: plays many games between two policies on every core
+//
+// Options:
+//   -n N           games to play (default 1000000)
+//   -t N           worker threads (default: all hardware threads)
+//   -1 policy      player 1 policy (default random)
+//   -2 policy      player 2 policy (default random)
+//   -s seed        base random seed (default 1)
+//   --record path  append every game to a record file (engine ids 1 and 2 are players 1 and 2)
+//   --board 8x7    play on the 8 column, 7 row board instead of the standard one
+//
+// Policies: random, greedy, search:N (depth), search:N:weights (depth, learned evaluator),
+//           mcts:N (playouts per move)
+
+#include "policy.h"
+#include "record.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using std::cout, std::cerr, std::endl;
+
+// Results of one worker, padded so workers never share a cache line
+struct alignas(64) SimulationStats
+{
+    unsigned long long games = 0;
+    unsigned long long player1Wins = 0;
+    unsigned long long player2Wins = 0;
+    unsigned long long draws = 0;
+    unsigned long long moves = 0;
+};
+
+// Play a share of the games with policies and a random generator owned by this thread
+// Each worker has its own record writer, writers append whole blocks so they can share the file
+template<typename Game>
+void runWorker(SimulationStats& stats, unsigned long long games, const std::string& spec1,
+               const std::string& spec2, uint64_t seed, const std::string& recordPath)
+{
+    std::unique_ptr<BasicPolicy<Game>> policies[2] = {createPolicy<Game>(spec1), createPolicy<Game>(spec2)};
+    Random random(seed);
+    Game game;
+    RecordWriter writer;
+    if(!recordPath.empty())
+        writer.open(recordPath, game.getRows(), game.getCols());
+
+    for(unsigned long long i = 0; i < games; ++i)
+    {
+        game.resetGame();
+        while(!game.isGameOver())
+            game.dropPiece(policies[game.getCurrentPlayer() - 1]->chooseMove(game, random));
+        if(writer.isOpen())
+            writer.add(game, 1, 2);
+
+        ++stats.games;
+        stats.moves += game.getMoveCount();
+        if(game.getWinner() == Game::PLAYER1)
+            ++stats.player1Wins;
+        else if(game.getWinner() == Game::PLAYER2)
+            ++stats.player2Wins;
+        else
+            ++stats.draws;
+    }
+}
+
+// Check the policies, play every game on the threads and print the totals
+template<typename Game>
+int simulate(unsigned long long games, int threads, const std::string& spec1, const std::string& spec2,
+             uint64_t seed, const std::string& recordPath)
+{
+    if(!createPolicy<Game>(spec1) || !createPolicy<Game>(spec2))
+    {
+        cerr << "Unknown policy (or weights that don't load), use random, greedy, search:N, search:N:weights or mcts:N" << endl;
+        return 1;
+    }
+
+    // Create the file (or check it matches) before the workers start appending
+    if(!recordPath.empty())
+    {
+        RecordWriter writer;
+        if(!writer.open(recordPath, Game::ROWS, Game::COLS))
+        {
+            cerr << "Can't record to " << recordPath << endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Split the games evenly, the first workers take the remainder
+    std::vector<SimulationStats> stats(threads);
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i)
+    {
+        unsigned long long share = games / threads + (static_cast<unsigned long long>(i) < games % threads ? 1 : 0);
+        workers.emplace_back(runWorker<Game>, std::ref(stats[i]), share, spec1, spec2, seed + i, recordPath);
+    }
+    for(std::thread& worker : workers)
+        worker.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    SimulationStats total;
+    for(const SimulationStats& s : stats)
+    {
+        total.games += s.games;
+        total.player1Wins += s.player1Wins;
+        total.player2Wins += s.player2Wins;
+        total.draws += s.draws;
+        total.moves += s.moves;
+    }
+
+    double n = total.games ? static_cast<double>(total.games) : 1.0;
+    cout << "Player 1 (" << spec1 << ") vs Player 2 (" << spec2 << ")" << endl;
+    cout << "Games:          " << total.games << endl;
+    cout << "Player 1 wins:  " << 100.0 * total.player1Wins / n << "%" << endl;
+    cout << "Player 2 wins:  " << 100.0 * total.player2Wins / n << "%" << endl;
+    cout << "Draws:          " << 100.0 * total.draws / n << "%" << endl;
+    cout << "Average length: " << total.moves / n << " moves" << endl;
+    cout << "Time:           " << elapsed.count() << " s" << endl;
+    cout << "Games/sec:      " << static_cast<long long>(total.games / elapsed.count()) << endl;
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned long long games = 1000000;
+    int threads = std::thread::hardware_concurrency();
+    std::string spec1 = "random";
+    std::string spec2 = "random";
+    uint64_t seed = 1;
+    std::string recordPath;
+    bool board8x7 = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            games = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-1") == 0 && i + 1 < argc)
+            spec1 = argv[++i];
+        else if(strcmp(argv[i], "-2") == 0 && i + 1 < argc)
+            spec2 = argv[++i];
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if(strcmp(argv[i], "--board") == 0 && i + 1 < argc && strcmp(argv[i + 1], "8x7") == 0)
+        {
+            board8x7 = true;
+            ++i;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-n games] [-t threads] [-1 policy] [-2 policy] [-s seed] [--record path] [--board 8x7]" << endl;
+            return 1;
+        }
+    }
+    if(threads < 1)
+        threads = 1;
+
+    if(board8x7)
+        return simulate<Connect4Game8x7>(games, threads, spec1, spec2, seed, recordPath);
+    return simulate<Connect4Game>(games, threads, spec1, spec2, seed, recordPath);
+}
@@ -0,0 +1,171 @@
+// Connect 4
+// Command line solver: reads one position per line and prints its exact score
+//
+// Positions are written as the columns played so far, numbered from 1
+// (e.g. "4453"). Anything after the moves on a line is ignored.
+// Output per line: moves score bestColumn nodes microseconds nodesPerSecond
+//
+// Options:
+//   -b path    opening book to consult before searching
+//   -e path    endgame table the search stops at
+//   -t N       search on N threads (0 = all hardware threads)
+//   -m MB      transposition table size (default 64, at least 8 so keys stay exact)
+//   --scaling  solve every position with the single-threaded solver, then with
+//              1, 2, 4 ... N threads, each from a cold table, and print the time
+//              of each and its speedup over the single-threaded solver
+
+#include "parallel_solver.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using std::cout, std::cerr, std::endl;
+
+void printResult(const std::string& moves, const SolverResult& result)
+{
+    cout << (moves.empty() ? "-" : moves) << " " << result.score << " " << result.bestMove + 1 << " "
+         << result.nodeCount << " " << static_cast<long long>(result.seconds * 1e6) << " "
+         << static_cast<long long>(result.getNodesPerSecond()) << endl;
+}
+
+// Table size and how well it did, on stderr so results stay easy to parse
+void printTableStats(const TranspositionTable& table)
+{
+    TableStats stats = table.getStats();
+    cerr << "Table: " << table.getBytes() / 1048576.0 << " MB, " << table.getSize() << " entries"
+         << (table.usesHugePages() ? ", huge pages" : "") << ", hit rate " << 100.0 * stats.getHitRate()
+         << "%, eviction rate " << 100.0 * stats.getEvictionRate() << "%" << endl;
+}
+
+// Solve with Connect4Solver, then with every power of two thread count up to maxThreads,
+// each from a cold table, comparing time and score with the single-threaded solver
+void printScaling(const std::string& moves, const Connect4Game& game, int maxThreads, size_t tableMB,
+                  const OpeningBook* book, const OpeningBook* endgame)
+{
+    std::string name = moves.empty() ? "-" : moves;
+    SolverResult base;
+    {
+        TranspositionTable table(tableMB);
+        Connect4Solver solver(&table);
+        solver.setBook(book);
+        solver.setEndgameTable(endgame);
+        base = solver.solve(game);
+    }
+    cout << name << " sequential score " << base.score << " seconds " << base.seconds << endl;
+
+    ParallelSolver solver(0, tableMB);
+    solver.setBook(book);
+    solver.setEndgameTable(endgame);
+    for(int threads = 1; ; threads *= 2)
+    {
+        if(threads > maxThreads)
+            threads = maxThreads;
+
+        solver.setThreadCount(threads);
+        solver.reset();
+        SolverResult result = solver.solve(game);
+
+        cout << name << " threads " << threads << " score " << result.score
+             << " seconds " << result.seconds << " speedup "
+             << (result.seconds > 0 ? base.seconds / result.seconds : 0.0)
+             << (result.score != base.score ? " MISMATCH" : "") << endl;
+
+        if(threads == maxThreads)
+            break;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = -1; // Single-threaded solver unless -t is given
+    bool scaling = false;
+    size_t tableMB = TranspositionTable::DEFAULT_MB;
+    OpeningBook book;
+    OpeningBook endgame;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            if(!book.open(argv[++i]))
+            {
+                cerr << "Could not open book " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            if(!endgame.open(argv[++i]))
+            {
+                cerr << "Could not open endgame table " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            tableMB = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--scaling") == 0)
+            scaling = true;
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-b book] [-e endgame] [-t threads] [-m MB] [--scaling] < positions" << endl;
+            return 1;
+        }
+    }
+
+    // Every solver reserves its own table, so only the one this mode runs is built
+    // (--scaling builds a fresh one per position)
+    std::unique_ptr<TranspositionTable> table;
+    std::unique_ptr<Connect4Solver> solver;
+    std::unique_ptr<ParallelSolver> parallelSolver;
+    if(threads >= 0 && !scaling)
+    {
+        parallelSolver.reset(new ParallelSolver(threads, tableMB));
+        parallelSolver->setBook(book.isOpen() ? &book : nullptr);
+        parallelSolver->setEndgameTable(endgame.isOpen() ? &endgame : nullptr);
+    }
+    else if(!scaling)
+    {
+        table.reset(new TranspositionTable(tableMB));
+        solver.reset(new Connect4Solver(table.get()));
+        solver->setBook(book.isOpen() ? &book : nullptr);
+        solver->setEndgameTable(endgame.isOpen() ? &endgame : nullptr);
+    }
+
+    int maxThreads = (threads > 0) ? threads : std::thread::hardware_concurrency();
+    if(maxThreads < 1)
+        maxThreads = 1;
+    std::string line;
+
+    while(std::getline(std::cin, line))
+    {
+        std::istringstream fields(line);
+        std::string moves;
+        fields >> moves;
+
+        Connect4Game game;
+        if(!game.playSequence(moves) || game.isGameOver())
+        {
+            cerr << "Invalid position: " << line << endl;
+            continue;
+        }
+
+        if(scaling)
+            printScaling(moves, game, maxThreads, tableMB, book.isOpen() ? &book : nullptr,
+                         endgame.isOpen() ? &endgame : nullptr);
+        else if(parallelSolver)
+            printResult(moves, parallelSolver->solve(game));
+        else
+            printResult(moves, solver->solve(game));
+    }
+
+    if(!scaling)
+        printTableStats(parallelSolver ? parallelSolver->getTable() : *table);
+
+    return 0;
+}
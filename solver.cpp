@@ -0,0 +1,383 @@
+// Connect 4
+// Contains function implementations for the perfect play solver
+
+#include "solver.h"
+#include "perf.h"
+#include <chrono>
+
+static_assert(Connect4Game::COL_BITS * Connect4Game::COLS <= TranspositionTable::DEFAULT_KEY_BITS,
+              "Tables are sized for the solver's position keys");
+
+double SolverResult::getNodesPerSecond() const
+{
+    return seconds > 0 ? nodeCount / seconds : 0.0;
+}
+
+Connect4Solver::Connect4Solver(TranspositionTable* sharedTable):
+    ownTable(sharedTable ? nullptr : new TranspositionTable()),
+    table(sharedTable ? *sharedTable : *ownTable),
+    nodeCount(0),
+    book(nullptr),
+    endgame(nullptr),
+    cells(0),
+    bookPlies(-1),
+    endgamePlies(1000),
+    stopped(false)
+{
+}
+
+
+
+// Analysis
+//----------------------------------------------------------------------------------------//
+
+// Find the exact score and a best move for the current position
+SolverResult Connect4Solver::solve(const Connect4Game& game)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned long long startNodes = nodeCount;
+
+    SolverResult result;
+    prepare(game);
+    table.newSearch();
+    if(!bookScore(game, result.score, result.bestMove))
+    {
+        result.score = scorePosition(game);
+        result.bestMove = game.isGameOver() ? -1 : findBestMove(game, result.score);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.nodeCount = nodeCount - startNodes;
+    result.seconds = elapsed.count();
+
+    return result;
+}
+
+// Narrow down the exact score with a series of null window searches
+int Connect4Solver::scorePosition(const Connect4Game& game)
+{
+    prepare(game);
+
+    int score, bestMove;
+    if(knownScore(game, score) || bookScore(game, score, bestMove))
+        return score;
+
+    // The search plays and takes back moves on its own copy
+    Connect4Game position = game;
+    int moveCount = game.getMoveCount();
+    int min = -(cells - moveCount) / 2;
+    int max = (cells + 1 - moveCount) / 2;
+
+    while(min < max)
+    {
+        // Probe near zero first, those searches are the cheapest
+        int med = min + (max - min) / 2;
+        if(med <= 0 && min / 2 < med)
+            med = min / 2;
+        else if(med >= 0 && max / 2 > med)
+            med = max / 2;
+
+        int r = negamax(position, med, med + 1);
+        if(r <= med)
+            max = r;
+        else
+            min = r;
+    }
+
+    return min;
+}
+
+// Alpha-beta search of a single window, the result r is exact when alpha < r < beta,
+// an upper bound when r <= alpha and a lower bound when r >= beta
+int Connect4Solver::searchWindow(const Connect4Game& game, int alpha, int beta)
+{
+    prepare(game);
+
+    int score;
+    if(knownScore(game, score))
+        return score;
+
+    Connect4Game position = game;
+    return negamax(position, alpha, beta);
+}
+
+// Exact score and best move if the position is stored in the book or endgame table
+bool Connect4Solver::lookupStored(const Connect4Game& game, int& score, int& bestMove)
+{
+    prepare(game);
+    return bookScore(game, score, bestMove);
+}
+
+// Forget cached positions
+void Connect4Solver::reset()
+{
+    table.clear();
+    nodeCount = 0;
+}
+
+
+
+// Setters
+//----------------------------------------------------------------------------------------//
+
+void Connect4Solver::setBook(const OpeningBook* openingBook)
+{
+    book = openingBook;
+}
+
+void Connect4Solver::setEndgameTable(const OpeningBook* table)
+{
+    endgame = table;
+}
+
+void Connect4Solver::setStop(std::function<bool()> stop)
+{
+    this->stop = std::move(stop);
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+unsigned long long Connect4Solver::getNodeCount() const
+{
+    return nodeCount;
+}
+
+bool Connect4Solver::wasStopped() const
+{
+    return stopped;
+}
+
+const TranspositionTable& Connect4Solver::getTable() const
+{
+    return table;
+}
+
+
+
+// Private Helper Methods
+//----------------------------------------------------------------------------------------//
+
+// Set up board size dependent data
+void Connect4Solver::prepare(const Connect4Game& game)
+{
+    stopped = false;
+    int cols = game.getCols();
+    cells = game.getRows() * cols;
+
+    // Center column first, then alternate outwards (3, 2, 4, 1, 5, 0, 6 for 7 columns)
+    columnOrder.resize(cols);
+    for(int i = 0; i < cols; ++i)
+        columnOrder[i] = cols / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+
+    // Tables made for another board size are ignored
+    bool bookFits = book && book->getRows() == game.getRows() && book->getCols() == cols;
+    bookPlies = bookFits ? book->getPlies() : -1;
+
+    bool endgameFits = endgame && endgame->getRows() == game.getRows() && endgame->getCols() == cols;
+    endgamePlies = endgameFits ? endgame->getMinPlies() : cells + 1;
+}
+
+// Exact score from the opening book or endgame table, if the position is in one
+bool Connect4Solver::bookScore(const Connect4Game& game, int& score, int& bestMove) const
+{
+    int moveCount = game.getMoveCount();
+    const OpeningBook* source = (moveCount <= bookPlies) ? book : (moveCount >= endgamePlies) ? endgame : nullptr;
+    if(!source)
+        return false;
+
+    // Tables store one of each mirrored pair, flip the move back if needed
+    bool mirrored;
+    if(!source->lookup(game.getCanonicalKey(mirrored), score, bestMove))
+        return false;
+    if(mirrored)
+        bestMove = Connect4Game::mirrorColumn(bestMove);
+
+    return true;
+}
+
+// Scores that need no search: finished games and immediate wins
+bool Connect4Solver::knownScore(const Connect4Game& game, int& score) const
+{
+    int moveCount = game.getMoveCount();
+
+    // A finished game was either won by the player who just moved or tied
+    if(game.isGameOver())
+    {
+        score = (game.getWinner() > 0) ? -(cells + 2 - moveCount) / 2 : 0;
+        return true;
+    }
+
+    // Immediate wins are not handled by negamax()
+    if(game.canWinNext())
+    {
+        score = (cells + 1 - moveCount) / 2;
+        return true;
+    }
+
+    return false;
+}
+
+// Lowest bound the search can store, table values count up from 1 at this score
+int Connect4Solver::minScore() const
+{
+    return -cells / 2;
+}
+
+// Negamax with alpha-beta pruning, the position must not be won already
+// and the current player must not be able to win on this move.
+// Returns 0 once stopped without storing anything, the caller throws the result away
+int Connect4Solver::negamax(Connect4Game& game, int alpha, int beta)
+{
+    ++nodeCount;
+    PERF_COUNT(Nodes);
+
+    if(stop && (nodeCount & (STOP_INTERVAL - 1)) == 0 && stop())
+        stopped = true;
+    if(stopped)
+        return 0;
+
+    // Only moves that don't hand the opponent a win are searched, a forced
+    // block leaves a single one and two threats can't both be blocked
+    Connect4Game::Bitboard moves = game.getNonLosingMoves();
+    int moveCount = game.getMoveCount();
+    if(!moves)
+        return -(cells - moveCount) / 2;
+    if(moveCount >= cells - 2)
+        return 0; // Neither of the last two pieces can win, so it's a draw
+
+    int bookValue, bookMove;
+    if(bookScore(game, bookValue, bookMove))
+        return bookValue;
+
+    // Lower bound: the opponent can't win on their next move either
+    int min = -(cells - 2 - moveCount) / 2;
+    if(alpha < min)
+    {
+        alpha = min;
+        if(alpha >= beta)
+            return alpha;
+    }
+
+    // Start with an upper bound: we can't win on our next move. An earlier visit left either
+    // a tighter upper bound or a lower bound, and the move that reached it when there was one
+    // (stored for the canonical side, so it may need flipping)
+    int max = (cells - 1 - moveCount) / 2;
+    bool mirrored;
+    uint64_t key = game.getCanonicalKey(mirrored);
+    int storedMove = -1;
+    TableEntry entry;
+    if(table.probe(key, entry))
+    {
+        int value = entry.value + minScore() - 1;
+        if(entry.bound == Bound::Lower)
+        {
+            if(alpha < value)
+            {
+                alpha = value;
+                if(alpha >= beta)
+                    return alpha;
+            }
+        }
+        else if(value < max)
+            max = value;
+
+        if(entry.move >= 0)
+            storedMove = mirrored ? Connect4Game::mirrorColumn(entry.move) : entry.move;
+    }
+
+    if(beta > max)
+    {
+        beta = max;
+        if(alpha >= beta)
+            return beta;
+    }
+
+    // The stored move first, then the moves that leave the most winning cells behind,
+    // ties in center-first order
+    int order[16];
+    int threats[16];
+    int count = 0;
+    for(int col : columnOrder)
+    {
+        Connect4Game::Bitboard cell = moves & Connect4Game::columnMask(col);
+        if(!cell)
+            continue;
+
+        int score = (col == storedMove) ? 1000 : __builtin_popcountll(game.getWinningCellsAfter(cell));
+        int i = count++;
+        for(; i > 0 && threats[i - 1] < score; --i)
+        {
+            order[i] = order[i - 1];
+            threats[i] = threats[i - 1];
+        }
+        order[i] = col;
+        threats[i] = score;
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+        int col = order[i];
+        game.dropPiece(col);
+        int score = -negamax(game, -beta, -alpha);
+        game.undoMove();
+        if(stopped)
+            return 0;
+
+        // Remember the lower bound and the move that proved it
+        if(score >= beta)
+        {
+            int move = mirrored ? Connect4Game::mirrorColumn(col) : col;
+            table.store(key, TableEntry{static_cast<uint8_t>(score - minScore() + 1), Bound::Lower, move, cells - moveCount});
+            return score;
+        }
+        if(score > alpha)
+            alpha = score;
+    }
+
+    // Remember the upper bound, keeping the move an earlier visit found
+    int move = (storedMove >= 0 && mirrored) ? Connect4Game::mirrorColumn(storedMove) : storedMove;
+    table.store(key, TableEntry{static_cast<uint8_t>(alpha - minScore() + 1), Bound::Upper, move, cells - moveCount});
+    return alpha;
+}
+
+// Pick a move that keeps the score, checked with cheap null window searches
+int Connect4Solver::findBestMove(const Connect4Game& game, int score)
+{
+    Connect4Game position = game;
+    int moveCount = game.getMoveCount();
+    int fallback = -1;
+
+    for(int col : columnOrder)
+    {
+        if(game.isColumnFull(col))
+            continue;
+        if(game.isWinningMove(col))
+            return col;
+        if(fallback == -1)
+            fallback = col;
+
+        position.dropPiece(col);
+
+        int childScore;
+        if(position.isGameOver())
+            childScore = 0; // Filled the last cell without winning
+        else
+        {
+            // The opponent must not have an immediate win after this move
+            if(position.canWinNext())
+                childScore = (cells + 1 - (moveCount + 1)) / 2;
+            else
+                childScore = negamax(position, -score, -score + 1);
+        }
+
+        position.undoMove();
+
+        if(childScore <= -score)
+            return col;
+    }
+
+    return fallback;
+}
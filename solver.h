@@ -0,0 +1,79 @@
+// Connect 4
+// Solver header file
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "book.h"
+#include "connect4.h"
+#include "transposition.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Outcome of solving one position
+struct SolverResult
+{
+    int score;       // > 0 the player to move wins, < 0 they lose, 0 draw
+    int bestMove;    // Column to play, -1 when the game is already over
+    unsigned long long nodeCount;
+    double seconds;
+
+    double getNodesPerSecond() const;
+};
+
+/*
+Scores follow the usual convention: a win with your last piece being your
+k-th piece scores (ROWS * COLS / 2 + 1 - k), so faster wins score higher.
+A loss is the negative score of the opponent's win.
+*/
+
+// Perfect play solver built on Connect4Game
+class Connect4Solver
+{
+    public:
+        // Uses its own table unless one is given to share with other solvers
+        Connect4Solver(TranspositionTable* sharedTable = nullptr);
+
+        // Analysis
+        SolverResult solve(const Connect4Game& game);
+        int scorePosition(const Connect4Game& game); // Exact score only, no best move
+        int searchWindow(const Connect4Game& game, int alpha, int beta);
+        bool lookupStored(const Connect4Game& game, int& score, int& bestMove); // Book or endgame table only
+        void reset(); // Forget cached positions
+
+        // Setters
+        void setBook(const OpeningBook* openingBook); // Checked before any search
+        void setEndgameTable(const OpeningBook* table); // Cuts the search off once it reaches the table
+        void setStop(std::function<bool()> stop);       // Asked every STOP_INTERVAL nodes, true abandons the search
+
+        // Getters
+        unsigned long long getNodeCount() const;
+        const TranspositionTable& getTable() const;
+        bool wasStopped() const; // The last search was abandoned, its result is meaningless
+
+        static const unsigned STOP_INTERVAL = 1024; // Nodes between stop checks, a power of two
+
+    private:
+        std::unique_ptr<TranspositionTable> ownTable;
+        TranspositionTable& table;
+        unsigned long long nodeCount;
+        const OpeningBook* book;
+        const OpeningBook* endgame;
+        std::vector<int> columnOrder; // Center columns first
+        int cells;                    // ROWS * COLS of the game being solved
+        int bookPlies;                // Deepest book position, -1 if the book doesn't fit the game
+        int endgamePlies;             // First ply of the endgame table, past the last ply if there is none
+        std::function<bool()> stop;
+        bool stopped;
+
+        // Helper methods
+        void prepare(const Connect4Game& game);
+        bool knownScore(const Connect4Game& game, int& score) const;
+        bool bookScore(const Connect4Game& game, int& score, int& bestMove) const;
+        int negamax(Connect4Game& game, int alpha, int beta);
+        int findBestMove(const Connect4Game& game, int score);
+        int minScore() const;
+};
+
+#endif
@@ -0,0 +1,419 @@
+// Connect 4
+// Tournament runner: plays engine configurations against each other on every core
+//
+// Engines are policy specs given as arguments (random, greedy, search:N,
+// search:N:weights, mcts:N). Every pairing plays each opening of the suite
+// twice with colors swapped, so neither engine gets the better side of an
+// opening more often than the other.
+// Results are reported as Elo with a 95% error bar for each pairing.
+//
+// Options:
+//   -g N           games per pairing (default: each opening twice)
+//   -t N           worker threads (default: all hardware threads)
+//   -d N           opening suite of every distinct position after N plies (default 2)
+//   -i path        opening suite from a file, one move string per line
+//   -s seed        base random seed (default 1)
+//   --gauntlet     play the first engine against each of the others only
+//   --sprt e0,e1   stop a pairing once the first engine is shown to be e0 (H0) or
+//                  e1 (H1) Elo stronger, with 5% error rates, after 30 games at least
+//   --record path  append every game to a record file (engine ids are argument order from 1)
+
+#include "policy.h"
+#include "record.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using std::cout, std::cerr, std::endl;
+
+// A game played but not yet tallied
+struct FinishedGame
+{
+    Connect4Game game;
+    int first, second; // Engines in move order
+    bool swapped;
+};
+
+// Running score of one pairing, counted for its first engine
+struct PairingResult
+{
+    int engine1, engine2;
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+    double llr = 0.0;
+    int sprtResult = 0; // 1 H1 accepted, -1 H0 accepted, 0 still running
+    std::atomic<bool> stopped{false};
+    std::unordered_map<int, FinishedGame> waiting; // First game of a color-swapped pair, until its partner ends
+
+    int getGames() const { return wins + draws + losses; }
+};
+
+// One game of the schedule
+struct MatchJob
+{
+    int pairing;
+    int opening;
+    bool swapped; // Second engine of the pairing moves first
+    int pair;     // Color-swapped pair of games it belongs to, -1 for a last game with no partner
+};
+
+// Sequential probability ratio test settings
+struct SPRTBounds
+{
+    bool enabled = false;
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+    int minGames = 30; // No decision before this, a handful of games says little about a close pairing
+};
+
+// Expected score of the stronger side for an Elo difference
+double eloToScore(double elo)
+{
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+double scoreToElo(double score)
+{
+    if(score <= 0.0)
+        return -INFINITY;
+    if(score >= 1.0)
+        return INFINITY;
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+// Mean score and its variance per game for a win/draw/loss count
+void scoreStats(double wins, double draws, double losses, double& score, double& variance)
+{
+    double n = wins + draws + losses;
+    score = (wins + 0.5 * draws) / n;
+    variance = (wins * (1.0 - score) * (1.0 - score) + draws * (0.5 - score) * (0.5 - score) +
+                losses * score * score) / n;
+}
+
+// Log likelihood ratio of H1 over H0 using the normal approximation of the score.
+// Half a game is added to each of win, draw and loss for the score and variance,
+// so a run of identical results has a small variance, not none, and can still decide
+double computeLLR(const PairingResult& r, const SPRTBounds& sprt)
+{
+    double score, variance;
+    scoreStats(r.wins + 0.5, r.draws + 0.5, r.losses + 0.5, score, variance);
+
+    double s0 = eloToScore(sprt.elo0);
+    double s1 = eloToScore(sprt.elo1);
+    return (s1 - s0) * (2.0 * score - s0 - s1) * (r.getGames() + 1.5) / (2.0 * variance);
+}
+
+// Every distinct unfinished position after exactly plies moves, mirror images counted once
+std::vector<std::string> generateOpenings(int plies)
+{
+    std::vector<std::pair<Connect4Game, std::string>> layer(1);
+    for(int ply = 0; ply < plies; ++ply)
+    {
+        std::vector<std::pair<Connect4Game, std::string>> next;
+        std::unordered_set<uint64_t> seen;
+        for(const auto& position : layer)
+        {
+            for(int col = 0; col < position.first.getCols(); ++col)
+            {
+                Connect4Game game = position.first;
+                if(!game.dropPiece(col) || game.isGameOver())
+                    continue;
+
+                if(seen.insert(game.getCanonicalKey()).second)
+                    next.emplace_back(game, position.second + char('1' + col));
+            }
+        }
+        layer.swap(next);
+    }
+
+    std::vector<std::string> openings;
+    for(const auto& position : layer)
+        openings.push_back(position.second);
+    return openings;
+}
+
+std::string formatElo(double elo)
+{
+    if(std::isinf(elo))
+        return elo > 0 ? "+inf" : "-inf";
+
+    char text[32];
+    snprintf(text, sizeof(text), "%+.1f", elo);
+    return text;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> specs;
+    int gamesPerPairing = 0;
+    int threads = std::thread::hardware_concurrency();
+    int openingPlies = 2;
+    std::string openingPath;
+    uint64_t seed = 1;
+    bool gauntlet = false;
+    SPRTBounds sprt;
+    std::string recordPath;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            gamesPerPairing = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            openingPlies = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            openingPath = argv[++i];
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--gauntlet") == 0)
+            gauntlet = true;
+        else if(strcmp(argv[i], "--sprt") == 0 && i + 1 < argc &&
+                sscanf(argv[++i], "%lf,%lf", &sprt.elo0, &sprt.elo1) == 2)
+            sprt.enabled = true;
+        else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if(argv[i][0] != '-' && specs.size() < 255)
+            specs.push_back(argv[i]);
+        else
+        {
+            specs.clear();
+            break;
+        }
+    }
+    if(threads < 1)
+        threads = 1;
+
+    if(specs.size() < 2)
+    {
+        cerr << "Usage: " << argv[0] << " [-g games] [-t threads] [-d plies | -i openings] [-s seed] [--gauntlet]"
+             << " [--sprt elo0,elo1] [--record path] engine engine..." << endl;
+        return 1;
+    }
+    for(const std::string& spec : specs)
+    {
+        if(!createPolicy(spec))
+        {
+            cerr << "Unknown engine " << spec << " (or weights that don't load), use random, greedy, search:N, search:N:weights or mcts:N" << endl;
+            return 1;
+        }
+    }
+
+    // Opening suite
+    std::vector<std::string> openings;
+    if(!openingPath.empty())
+    {
+        std::ifstream file(openingPath);
+        if(!file)
+        {
+            cerr << "Could not open " << openingPath << endl;
+            return 1;
+        }
+
+        std::string line;
+        while(std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            std::string moves;
+            fields >> moves;
+
+            Connect4Game game;
+            if(moves == "-")
+                moves.clear();
+            if(!game.playSequence(moves) || game.isGameOver())
+            {
+                cerr << "Invalid opening: " << line << endl;
+                continue;
+            }
+            openings.push_back(moves);
+        }
+    }
+    else
+        openings = generateOpenings(openingPlies);
+
+    if(openings.empty())
+    {
+        cerr << "No openings" << endl;
+        return 1;
+    }
+    if(gamesPerPairing <= 0)
+        gamesPerPairing = 2 * openings.size();
+
+    // Pairings, then games ordered so every pairing progresses at the same rate
+    std::vector<std::unique_ptr<PairingResult>> pairings;
+    for(size_t a = 0; a < specs.size(); ++a)
+    {
+        for(size_t b = a + 1; b < specs.size(); ++b)
+        {
+            if(gauntlet && a != 0)
+                break;
+            pairings.emplace_back(new PairingResult());
+            pairings.back()->engine1 = a;
+            pairings.back()->engine2 = b;
+        }
+    }
+
+    std::vector<MatchJob> jobs;
+    for(int game = 0; game < gamesPerPairing; ++game)
+    {
+        int pair = (game % 2 == 0 && game + 1 == gamesPerPairing) ? -1 : game / 2;
+        for(size_t p = 0; p < pairings.size(); ++p)
+            jobs.push_back(MatchJob{static_cast<int>(p), static_cast<int>((game / 2) % openings.size()), game % 2 == 1, pair});
+    }
+
+    // Create the file (or check it matches) before the workers start appending
+    if(!recordPath.empty())
+    {
+        RecordWriter writer;
+        if(!writer.open(recordPath, Connect4Game::ROWS, Connect4Game::COLS))
+        {
+            cerr << "Can't record to " << recordPath << endl;
+            return 1;
+        }
+    }
+
+    std::atomic<size_t> nextJob(0);
+    std::atomic<size_t> finished(0);
+    std::mutex resultLock;
+    double lowerBound = std::log(sprt.beta / (1.0 - sprt.alpha));
+    double upperBound = std::log((1.0 - sprt.beta) / sprt.alpha);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Each worker has its own engines, since some keep state between moves
+    auto worker = [&]()
+    {
+        std::vector<std::unique_ptr<Policy>> engines;
+        for(const std::string& spec : specs)
+            engines.push_back(createPolicy(spec));
+
+        RecordWriter writer;
+        if(!recordPath.empty())
+            writer.open(recordPath, Connect4Game::ROWS, Connect4Game::COLS);
+
+        for(size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+        {
+            const MatchJob& job = jobs[j];
+            PairingResult& pairing = *pairings[job.pairing];
+            if(pairing.stopped.load())
+                continue;
+
+            int first = job.swapped ? pairing.engine2 : pairing.engine1;
+            int second = job.swapped ? pairing.engine1 : pairing.engine2;
+            Policy* players[2] = {engines[first].get(), engines[second].get()};
+
+            // Seeded by the job, so results don't depend on which thread plays it
+            Random random(seed * 0x9E3779B97F4A7C15ULL + j);
+            Connect4Game game;
+            game.playSequence(openings[job.opening]);
+            while(!game.isGameOver())
+                game.dropPiece(players[game.getCurrentPlayer() - 1]->chooseMove(game, random));
+
+            std::lock_guard<std::mutex> guard(resultLock);
+
+            // Both games of a color-swapped pair are tallied together, and the test is only asked
+            // between pairs, so the sample it decides on has every opening from both sides. Games
+            // still in flight when it decides are left out of W/D/L, Elo, LLR and the record file
+            std::vector<FinishedGame> tally;
+            if(!pairing.stopped.load())
+            {
+                FinishedGame result{game, first, second, job.swapped};
+                auto partner = pairing.waiting.find(job.pair);
+                if(job.pair < 0)
+                    tally.push_back(result);
+                else if(partner == pairing.waiting.end())
+                    pairing.waiting.emplace(job.pair, result);
+                else
+                {
+                    tally.push_back(partner->second);
+                    tally.push_back(result);
+                    pairing.waiting.erase(partner);
+                }
+            }
+
+            for(const FinishedGame& finishedGame : tally)
+            {
+                if(writer.isOpen())
+                    writer.add(finishedGame.game, finishedGame.first + 1, finishedGame.second + 1);
+
+                int winner = finishedGame.game.getWinner();
+                if(winner == -1)
+                    ++pairing.draws;
+                else if((winner == Connect4Game::PLAYER1) != finishedGame.swapped)
+                    ++pairing.wins;
+                else
+                    ++pairing.losses;
+            }
+
+            if(sprt.enabled && !tally.empty())
+            {
+                pairing.llr = computeLLR(pairing, sprt);
+                if(pairing.getGames() >= sprt.minGames && (pairing.llr >= upperBound || pairing.llr <= lowerBound))
+                {
+                    pairing.sprtResult = (pairing.llr >= upperBound) ? 1 : -1;
+                    pairing.stopped.store(true);
+                }
+            }
+
+            size_t done = ++finished;
+            if(done % 1000 == 0)
+                cerr << done << " games played" << endl;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i)
+        workers.emplace_back(worker);
+    for(std::thread& w : workers)
+        w.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    cout << openings.size() << " openings, " << finished.load() << " games in " << elapsed.count() << " s" << endl;
+    for(const std::unique_ptr<PairingResult>& p : pairings)
+    {
+        cout << specs[p->engine1] << " vs " << specs[p->engine2] << ": +" << p->wins << " =" << p->draws
+             << " -" << p->losses;
+        if(p->getGames() == 0)
+        {
+            cout << endl;
+            continue;
+        }
+
+        double score, variance;
+        scoreStats(p->wins, p->draws, p->losses, score, variance);
+        double margin = 1.96 * std::sqrt(variance / p->getGames());
+        double elo = scoreToElo(score);
+        double low = scoreToElo(score - margin);
+        double high = scoreToElo(score + margin);
+
+        cout << std::fixed << std::setprecision(1) << "  score " << 100.0 * score << "%  Elo " << formatElo(elo)
+             << " [" << formatElo(low) << ", " << formatElo(high) << "]";
+        cout.unsetf(std::ios::floatfield);
+        if(sprt.enabled)
+        {
+            cout << std::setprecision(3) << "  LLR " << p->llr << " (" << lowerBound << ", " << upperBound << ")"
+                 << (p->sprtResult > 0 ? " H1 accepted" : p->sprtResult < 0 ? " H0 accepted" : " inconclusive");
+            cout << std::setprecision(6);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
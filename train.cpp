@@ -0,0 +1,413 @@
+// Connect 4
+// Trains the learned evaluator's weights from game record files
+//
+// Every position of every finished game is a sample labelled with the result
+// for the side to move (win 1, draw 0.5, loss 0). The network is trained in
+// floating point by stochastic gradient descent on the log loss, each sample
+// mirrored half of the time, then quantized and checked on the held out games
+// with the integer evaluator the search uses.
+//
+// Usage: train [options] records...
+//   -o path   weights file to write (default eval.c4nn)
+//   -e N      epochs (default 10)
+//   -l rate   learning rate (default 0.01)
+//   -n N      most games to read (default 200000)
+//   -v N      percent of the games held out for validation (default 10)
+//   -s seed   random seed (default 1)
+
+#include "evaluator.h"
+#include "policy.h"
+#include "record.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using std::cout, std::cerr, std::endl;
+
+struct TrainOptions
+{
+    std::string outputPath = "eval.c4nn";
+    int epochs = 10;
+    float learningRate = 0.01f;
+    unsigned long long maxGames = 200000;
+    int validationPercent = 10;
+    uint64_t seed = 1;
+};
+
+// One position and the result of its game for the side to move
+template<typename Game>
+struct Sample
+{
+    typename Game::Bitboard pieces[2];
+    int player;
+    float target;
+};
+
+// Floating point copy of the evaluator network, with the same inputs and clamps
+template<typename Game>
+class Trainer
+{
+    public:
+        using Network = EvaluatorNetwork<Game>;
+        static const int CELLS = Network::CELLS;
+        static const int HIDDEN = Network::HIDDEN;
+
+        Trainer(Random& random): inputWeights(Network::INPUTS * HIDDEN), outputBias(0.0f)
+        {
+            // Bias the hidden values into the middle of the clamp so they all start learning
+            for(float& weight : inputWeights)
+                weight = uniform(random, 0.05f);
+            for(int i = 0; i < HIDDEN; ++i)
+                hiddenBias[i] = 0.5f;
+            for(float& weight : outputWeights)
+                weight = uniform(random, 0.1f);
+
+            inputLimit = INPUT_LIMIT / 127.0f;
+        }
+
+        // One gradient step, returns the loss before it
+        double step(const Sample<Game>& sample, bool mirror, float rate)
+        {
+            int features[2][CELLS];
+            int counts[2];
+            float accumulators[2][HIDDEN];
+            float out = forward(sample, mirror, features, counts, accumulators);
+
+            float prediction = 1.0f / (1.0f + std::exp(-out));
+            float gradient = prediction - sample.target;
+
+            for(int side = 0; side < 2; ++side)
+            {
+                float hiddenGradient[HIDDEN];
+                for(int i = 0; i < HIDDEN; ++i)
+                {
+                    float value = accumulators[side][i];
+                    float& weight = outputWeights[side * HIDDEN + i];
+                    hiddenGradient[i] = (value > 0.0f && value < 1.0f) ? gradient * weight : 0.0f;
+                    weight = std::clamp(weight - rate * gradient * std::clamp(value, 0.0f, 1.0f),
+                                        -OUTPUT_LIMIT, OUTPUT_LIMIT);
+                }
+
+                for(int f = 0; f < counts[side]; ++f)
+                {
+                    float* row = &inputWeights[features[side][f] * HIDDEN];
+                    for(int i = 0; i < HIDDEN; ++i)
+                        row[i] = std::clamp(row[i] - rate * hiddenGradient[i], -inputLimit, inputLimit);
+                }
+                for(int i = 0; i < HIDDEN; ++i)
+                    hiddenBias[i] = std::clamp(hiddenBias[i] - rate * hiddenGradient[i], -inputLimit, inputLimit);
+            }
+            outputBias -= rate * gradient;
+
+            return logLoss(out, sample.target);
+        }
+
+        double loss(const Sample<Game>& sample) const
+        {
+            int features[2][CELLS];
+            int counts[2];
+            float accumulators[2][HIDDEN];
+            return logLoss(forward(sample, false, features, counts, accumulators), sample.target);
+        }
+
+        // Round to the evaluator's fixed point scales
+        void quantize(Network& network) const
+        {
+            for(int input = 0; input < Network::INPUTS; ++input)
+            {
+                for(int i = 0; i < HIDDEN; ++i)
+                    network.inputWeights[input][i] = quantizeInput(inputWeights[input * HIDDEN + i]);
+            }
+            for(int i = 0; i < HIDDEN; ++i)
+                network.hiddenBias[i] = quantizeInput(hiddenBias[i]);
+            for(int i = 0; i < 2 * HIDDEN; ++i)
+                network.outputWeights[i] = static_cast<int8_t>(std::lround(outputWeights[i] * 64.0f));
+            network.outputBias = static_cast<int32_t>(std::lround(outputBias * 127.0f * 64.0f));
+        }
+
+    private:
+        // Every accumulator, bias plus one row per cell, must stay inside int16, so no
+        // quantized input weight may exceed this even after rounding
+        static const int INPUT_LIMIT = 32767 / (CELLS + 1);
+        static constexpr float OUTPUT_LIMIT = 127.0f / 64.0f; // Output weights must fit int8 once scaled by 64
+
+        std::vector<float> inputWeights; // INPUTS rows of HIDDEN
+        float hiddenBias[HIDDEN];
+        float outputWeights[2 * HIDDEN];
+        float outputBias;
+        float inputLimit;
+
+        static int16_t quantizeInput(float weight)
+        {
+            return static_cast<int16_t>(std::clamp<long>(std::lround(weight * 127.0f), -INPUT_LIMIT, INPUT_LIMIT));
+        }
+
+        static float uniform(Random& random, float range)
+        {
+            return range * (2.0f * static_cast<float>(random.next() >> 40) / (1 << 24) - 1.0f);
+        }
+
+        static double logLoss(float out, float target)
+        {
+            // log(1 + e^x) without overflow
+            auto softplus = [](double x) { return x > 0 ? x + std::log1p(std::exp(-x)) : std::log1p(std::exp(x)); };
+            return target * softplus(-out) + (1.0 - target) * softplus(out);
+        }
+
+        // Features seen from the side to move (side 0) and the other player (side 1), returns the output
+        float forward(const Sample<Game>& sample, bool mirror, int (&features)[2][CELLS], int (&counts)[2],
+                      float (&accumulators)[2][HIDDEN]) const
+        {
+            float out = outputBias;
+            for(int side = 0; side < 2; ++side)
+            {
+                int perspective = (side == 0) ? sample.player - 1 : 2 - sample.player;
+                counts[side] = 0;
+                for(int owner = 0; owner < 2; ++owner)
+                {
+                    int offset = (owner == perspective) ? 0 : CELLS;
+                    for(int col = 0; col < Game::COLS; ++col)
+                    {
+                        uint64_t column = static_cast<uint64_t>((sample.pieces[owner] >> (col * Game::COL_BITS)) &
+                                                                ((1u << Game::ROWS) - 1));
+                        int featureCol = mirror ? Game::COLS - 1 - col : col;
+                        for(; column; column &= column - 1)
+                            features[side][counts[side]++] = offset + featureCol * Game::ROWS + __builtin_ctzll(column);
+                    }
+                }
+
+                float* values = accumulators[side];
+                std::copy(hiddenBias, hiddenBias + HIDDEN, values);
+                for(int f = 0; f < counts[side]; ++f)
+                {
+                    const float* row = &inputWeights[features[side][f] * HIDDEN];
+                    for(int i = 0; i < HIDDEN; ++i)
+                        values[i] += row[i];
+                }
+                for(int i = 0; i < HIDDEN; ++i)
+                    out += outputWeights[side * HIDDEN + i] * std::clamp(values[i], 0.0f, 1.0f);
+            }
+
+            return out;
+        }
+};
+
+// Result of a game for the player to move
+float resultFor(const GameRecord& record, int player)
+{
+    int winner = record.getWinner();
+    if(winner == -1)
+        return 0.5f;
+    return (winner == player) ? 1.0f : 0.0f;
+}
+
+template<typename Game>
+int train(const std::vector<std::unique_ptr<RecordReader>>& readers, const TrainOptions& options)
+{
+    Random random(options.seed);
+    std::vector<Sample<Game>> trainSamples, validationSamples;
+    std::vector<GameRecord> validationGames;
+    unsigned long long games = 0;
+
+    // Samples from every finished game, validation games picked at random
+    for(const std::unique_ptr<RecordReader>& reader : readers)
+    {
+        RecordCursor cursor = reader->cursor();
+        GameRecord record;
+        while(games < options.maxGames && reader->next(cursor, record))
+        {
+            if(record.result == GameRecord::RESULT_NONE)
+                continue;
+
+            bool validation = random.nextInt(100) < options.validationPercent;
+            std::vector<Sample<Game>>& samples = validation ? validationSamples : trainSamples;
+            size_t firstSample = samples.size();
+            Game game;
+            for(int m = 0; m < record.length; ++m)
+            {
+                Sample<Game> sample;
+                sample.pieces[0] = game.getPlayerPieces(Game::PLAYER1);
+                sample.pieces[1] = game.getPlayerPieces(Game::PLAYER2);
+                sample.player = game.getCurrentPlayer();
+                sample.target = resultFor(record, sample.player);
+                samples.push_back(sample);
+
+                if(!game.dropPiece(record.getMove(m)))
+                    break;
+            }
+
+            if(game.getMoveCount() != record.length)
+            {
+                samples.resize(firstSample); // Does not replay, leave it out
+                continue;
+            }
+            if(validation)
+                validationGames.push_back(record);
+            ++games;
+        }
+    }
+
+    if(trainSamples.empty())
+    {
+        cerr << "No finished games to train on" << endl;
+        return 1;
+    }
+    cout << games << " games, " << trainSamples.size() << " training and " << validationSamples.size()
+         << " validation positions" << endl;
+
+    // Training
+    Trainer<Game> trainer(random);
+    std::vector<uint32_t> order(trainSamples.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    for(int epoch = 1; epoch <= options.epochs; ++epoch)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = order.size() - 1; i > 0; --i)
+            std::swap(order[i], order[random.next() % (i + 1)]);
+
+        double trainLoss = 0.0;
+        for(uint32_t index : order)
+            trainLoss += trainer.step(trainSamples[index], random.next() & 1, options.learningRate);
+
+        double validationLoss = 0.0;
+        for(const Sample<Game>& sample : validationSamples)
+            validationLoss += trainer.loss(sample);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        cout << "Epoch " << epoch << ": training loss " << trainLoss / trainSamples.size();
+        if(!validationSamples.empty())
+            cout << ", validation loss " << validationLoss / validationSamples.size();
+        cout << " (" << elapsed.count() << " s)" << endl;
+    }
+
+    std::unique_ptr<BasicEvaluator<Game>> evaluator(new BasicEvaluator<Game>());
+    std::unique_ptr<EvaluatorNetwork<Game>> network(new EvaluatorNetwork<Game>());
+    trainer.quantize(*network);
+    evaluator->setNetwork(*network);
+
+    // The integer evaluator on the held out games, scored in batches like search leaves
+    if(!validationGames.empty())
+    {
+        const size_t BATCH = 256;
+        std::vector<Game> batch;
+        std::vector<float> targets;
+        int scores[BATCH];
+        double quantizedLoss = 0.0;
+        unsigned long long positions = 0;
+        double seconds = 0.0;
+
+        auto scoreBatch = [&]()
+        {
+            auto start = std::chrono::steady_clock::now();
+            evaluator->evaluateBatch(batch.data(), batch.size(), scores);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for(size_t i = 0; i < batch.size(); ++i)
+            {
+                double out = static_cast<double>(scores[i]) / BasicEvaluator<Game>::SCORE_SCALE;
+                double prediction = 1.0 / (1.0 + std::exp(-out));
+                prediction = std::clamp(prediction, 1e-6, 1.0 - 1e-6);
+                quantizedLoss -= targets[i] * std::log(prediction) + (1.0 - targets[i]) * std::log(1.0 - prediction);
+            }
+            positions += batch.size();
+            batch.clear();
+            targets.clear();
+        };
+
+        for(const GameRecord& record : validationGames)
+        {
+            Game game;
+            for(int m = 0; m < record.length; ++m)
+            {
+                batch.push_back(game);
+                targets.push_back(resultFor(record, game.getCurrentPlayer()));
+                if(batch.size() == BATCH)
+                    scoreBatch();
+                game.dropPiece(record.getMove(m));
+            }
+        }
+        if(!batch.empty())
+            scoreBatch();
+
+        cout << "Quantized validation loss " << quantizedLoss / positions << ", "
+             << static_cast<long long>(positions / (seconds > 0 ? seconds : 1e-9)) << " evaluations/sec" << endl;
+    }
+
+    if(!evaluator->save(options.outputPath))
+    {
+        cerr << "Can't write " << options.outputPath << endl;
+        return 1;
+    }
+    cout << "Wrote " << options.outputPath << endl;
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    TrainOptions options;
+    std::vector<std::string> paths;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            options.outputPath = argv[++i];
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+            options.epochs = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            options.learningRate = atof(argv[++i]);
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            options.maxGames = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+            options.validationPercent = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        else if(argv[i][0] != '-')
+            paths.push_back(argv[i]);
+        else
+        {
+            paths.clear();
+            break;
+        }
+    }
+    if(paths.empty())
+    {
+        cerr << "Usage: " << argv[0] << " [-o weights] [-e epochs] [-l rate] [-n games] [-v percent] [-s seed] records..."
+             << endl;
+        return 1;
+    }
+
+    // Every record must be for the same board, which picks the network size
+    std::vector<std::unique_ptr<RecordReader>> readers;
+    for(const std::string& path : paths)
+    {
+        readers.emplace_back(new RecordReader());
+        if(!readers.back()->open(path))
+        {
+            cerr << "Can't read record file " << path << endl;
+            return 1;
+        }
+        if(readers.back()->getRows() != readers[0]->getRows() || readers.back()->getCols() != readers[0]->getCols())
+        {
+            cerr << path << " is for a different board size" << endl;
+            return 1;
+        }
+    }
+
+    int rows = readers[0]->getRows();
+    int cols = readers[0]->getCols();
+    if(rows == Connect4Game::ROWS && cols == Connect4Game::COLS)
+        return train<Connect4Game>(readers, options);
+    if(rows == Connect4Game8x7::ROWS && cols == Connect4Game8x7::COLS)
+        return train<Connect4Game8x7>(readers, options);
+
+    cerr << "No evaluator for a " << cols << "x" << rows << " board" << endl;
+    return 1;
+}
@@ -0,0 +1,470 @@
+// Connect 4
+// Contains function implementations for the transposition table
+
+#include "transposition.h"
+#include "perf.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+double TableStats::getHitRate() const
+{
+    return probes ? static_cast<double>(hits) / probes : 0.0;
+}
+
+double TableStats::getEvictionRate() const
+{
+    return stores ? static_cast<double>(replaced) / stores : 0.0;
+}
+
+namespace
+{
+    // Payload bit layout
+    const int VALUE_SHIFT = 0;  // 8 bits
+    const int BOUND_SHIFT = 8;  // 2 bits
+    const int MOVE_SHIFT = 10;  // 4 bits, move + 1
+    const int AGE_SHIFT = 14;   // 6 bits
+    const int DEPTH_SHIFT = 20; // 8 bits
+    const uint32_t AGE_MASK = 63;
+
+    const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    bool isPrime(size_t n)
+    {
+        if(n < 2)
+            return false;
+        for(size_t d = 2; d * d <= n; ++d)
+        {
+            if(n % d == 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Flush a file or directory to the disk, fsync() on a descriptor opened for reading
+    bool syncPath(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        bool synced = fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes, int keyBits): hugePages(false), age(0)
+{
+    // Keys below minBuckets * 2^32 leave a quotient that fits the 32-bit tag
+    minBuckets = keyBits > 32 ? size_t(1) << (keyBits - 32) : 2;
+
+    // The largest prime number of buckets that fits the budget, or the smallest one that keeps keys exact
+    bucketCount = (megabytes << 20) / sizeof(Bucket);
+    if(bucketCount < 2)
+        bucketCount = 2;
+    while(!isPrime(bucketCount))
+        --bucketCount;
+    if(bucketCount < minBuckets)
+    {
+        bucketCount = minBuckets;
+        while(!isPrime(bucketCount))
+            ++bucketCount;
+    }
+
+    // Explicit huge pages first, then ordinary pages with a transparent huge page hint
+    void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    bytes = (bucketCount * sizeof(Bucket) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugePages = (memory != MAP_FAILED);
+#endif
+    if(memory == MAP_FAILED)
+    {
+        bytes = bucketCount * sizeof(Bucket);
+        memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED)
+            throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        madvise(memory, bytes, MADV_HUGEPAGE); // Only a hint, usesHugePages() checks what the kernel did
+#endif
+    }
+
+    // Anonymous pages start zeroed, which is an empty table, so nothing is touched until used
+    mapping = memory;
+    buckets = static_cast<Bucket*>(memory);
+    for(size_t i = 0; i < bucketCount; ++i)
+        new(&buckets[i]) Bucket;
+
+    for(StatShard& s : stats)
+    {
+        s.probes.store(0);
+        s.hits.store(0);
+        s.stores.store(0);
+        s.replaced.store(0);
+    }
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    munmap(mapping, bytes);
+}
+
+
+
+// Table access
+//----------------------------------------------------------------------------------------//
+
+// Look up a position, false for a miss
+bool TranspositionTable::probe(uint64_t key, TableEntry& entry) const
+{
+    StatShard& counters = shard();
+    counters.probes.fetch_add(1, std::memory_order_relaxed);
+
+    const Bucket& b = bucket(key);
+    uint32_t tag = keyTag(key);
+    for(const std::atomic<uint64_t>& slot : b.entries)
+    {
+        uint64_t word = slot.load(std::memory_order_relaxed);
+        uint32_t payload = static_cast<uint32_t>(word);
+        if((static_cast<uint32_t>(word >> 32) ^ payload) == tag && (payload & 0xFF) != 0)
+        {
+            unpackPayload(payload, entry);
+            counters.hits.fetch_add(1, std::memory_order_relaxed);
+            PERF_COUNT(TableHits);
+            return true;
+        }
+    }
+
+    PERF_COUNT(TableMisses);
+    return false;
+}
+
+// Store a result: over the same position if it's there, else in an empty slot,
+// else over the entry with the least depth, an entry from an earlier search going first on a tie
+void TranspositionTable::store(uint64_t key, const TableEntry& entry)
+{
+    StatShard& counters = shard();
+    counters.stores.fetch_add(1, std::memory_order_relaxed);
+
+    Bucket& b = bucket(key);
+    uint32_t tag = keyTag(key);
+    uint32_t currentAge = age.load(std::memory_order_relaxed) & AGE_MASK;
+    uint32_t payload = packPayload(entry, currentAge);
+
+    int victim = 0;
+    int victimPriority = INT32_MAX;
+    bool evicts = true;
+    for(int i = 0; i < BUCKET_SIZE; ++i)
+    {
+        uint64_t word = b.entries[i].load(std::memory_order_relaxed);
+        uint32_t oldPayload = static_cast<uint32_t>(word);
+        if((oldPayload & 0xFF) == 0 || (static_cast<uint32_t>(word >> 32) ^ oldPayload) == tag)
+        {
+            victim = i;
+            evicts = false;
+            break;
+        }
+
+        // Age only breaks ties, so deep results survive any number of later searches,
+        // and an age that wrapped round to the current one at worst wins a tie it should lose
+        int depth = (oldPayload >> DEPTH_SHIFT) & 0xFF;
+        bool stale = ((oldPayload >> AGE_SHIFT) & AGE_MASK) != currentAge;
+        int priority = 2 * depth + (stale ? 0 : 1);
+        if(priority < victimPriority)
+        {
+            victim = i;
+            victimPriority = priority;
+        }
+    }
+
+    if(evicts)
+        counters.replaced.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t word = (static_cast<uint64_t>(tag ^ payload) << 32) | payload;
+    b.entries[victim].store(word, std::memory_order_relaxed);
+}
+
+// Entries stored before this count as one search older
+void TranspositionTable::newSearch()
+{
+    age.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Forget every stored position
+void TranspositionTable::clear()
+{
+    for(size_t i = 0; i < bucketCount; ++i)
+    {
+        for(std::atomic<uint64_t>& slot : buckets[i].entries)
+            slot.store(0, std::memory_order_relaxed);
+    }
+
+    for(StatShard& s : stats)
+    {
+        s.probes.store(0);
+        s.hits.store(0);
+        s.stores.store(0);
+        s.replaced.store(0);
+    }
+}
+
+// Write the table to a temporary file, flush it to the disk and rename it over the old
+// snapshot, so neither a crash nor a power loss leaves half a snapshot under path
+bool TranspositionTable::save(const std::string& path, int rows, int cols) const
+{
+    SnapshotHeader header = {};
+    memcpy(header.magic, "C4TT", 4);
+    header.version = SNAPSHOT_VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.bucketCount = bucketCount;
+    header.age = age.load();
+    header.bucketSize = BUCKET_SIZE;
+
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Copied a chunk at a time with atomic loads, searches may be writing meanwhile
+    const size_t CHUNK_WORDS = 1 << 17;
+    std::vector<uint64_t> chunk;
+    chunk.reserve(CHUNK_WORDS);
+    uint64_t hash = 0;
+    for(size_t i = 0; i < bucketCount && file; ++i)
+    {
+        for(const std::atomic<uint64_t>& slot : buckets[i].entries)
+            chunk.push_back(slot.load(std::memory_order_relaxed));
+
+        if(chunk.size() >= CHUNK_WORDS || i + 1 == bucketCount)
+        {
+            hash = checksum(chunk.data(), chunk.size(), hash);
+            file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(uint64_t));
+            chunk.clear();
+        }
+    }
+
+    header.checksum = hash;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    if(!file || !syncPath(temporary) || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    // The rename itself only lasts once the directory is flushed too
+    size_t slash = path.rfind('/');
+    syncPath(slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash));
+    return true;
+}
+
+// Map a snapshot copy-on-write and search on it in place, the table is left as it
+// was if the file is missing, damaged or from another board size. Not safe while searching
+bool TranspositionTable::load(const std::string& path, int rows, int cols)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping stays valid after the file is closed
+    if(data == MAP_FAILED)
+        return false;
+
+    const SnapshotHeader* header = static_cast<const SnapshotHeader*>(data);
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(header + 1);
+    bool valid = memcmp(header->magic, "C4TT", 4) == 0 && header->version == SNAPSHOT_VERSION &&
+                 header->rows == static_cast<uint32_t>(rows) && header->cols == static_cast<uint32_t>(cols) &&
+                 header->bucketSize == BUCKET_SIZE && header->bucketCount >= minBuckets &&
+                 info.st_size == static_cast<off_t>(sizeof(SnapshotHeader) + header->bucketCount * sizeof(Bucket));
+    if(valid)
+        valid = checksum(words, header->bucketCount * BUCKET_SIZE, 0) == header->checksum;
+    if(!valid)
+    {
+        munmap(data, info.st_size);
+        return false;
+    }
+
+    munmap(mapping, bytes);
+    mapping = data;
+    bytes = info.st_size;
+    buckets = reinterpret_cast<Bucket*>(static_cast<char*>(data) + sizeof(SnapshotHeader));
+    bucketCount = header->bucketCount;
+    hugePages = false;
+    age.store(header->age);
+
+    for(StatShard& s : stats)
+    {
+        s.probes.store(0);
+        s.hits.store(0);
+        s.stores.store(0);
+        s.replaced.store(0);
+    }
+    return true;
+}
+
+
+
+// Getters
+//----------------------------------------------------------------------------------------//
+
+size_t TranspositionTable::getSize() const
+{
+    return bucketCount * BUCKET_SIZE;
+}
+
+size_t TranspositionTable::getBytes() const
+{
+    return bytes;
+}
+
+// Explicit huge pages, or transparent huge pages the kernel has actually backed part of the
+// table with (a loaded snapshot or a table not yet written to may have none)
+bool TranspositionTable::usesHugePages() const
+{
+    if(hugePages)
+        return true;
+
+    // Each entry of /proc/self/smaps starts with its address range. The kernel may have merged
+    // the table with a neighbouring mapping, so look for the range that contains it
+    unsigned long address = reinterpret_cast<unsigned long>(mapping);
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while(std::getline(smaps, line))
+    {
+        unsigned long start, end;
+        if(sscanf(line.c_str(), "%lx-%lx ", &start, &end) == 2)
+            inside = (start <= address && address < end);
+        else if(inside && line.compare(0, 14, "AnonHugePages:") == 0)
+            return strtoull(line.c_str() + 14, nullptr, 10) > 0;
+    }
+
+    return false;
+}
+
+TableStats TranspositionTable::getStats() const
+{
+    TableStats total = {};
+    for(const StatShard& s : stats)
+    {
+        total.probes += s.probes.load(std::memory_order_relaxed);
+        total.hits += s.hits.load(std::memory_order_relaxed);
+        total.stores += s.stores.load(std::memory_order_relaxed);
+        total.replaced += s.replaced.load(std::memory_order_relaxed);
+    }
+
+    return total;
+}
+
+
+
+// Private Helper Methods
+//----------------------------------------------------------------------------------------//
+
+TranspositionTable::Bucket& TranspositionTable::bucket(uint64_t key) const
+{
+    return buckets[key % bucketCount];
+}
+
+// The rest of the key once the bucket is known, exact while key < bucketCount * 2^32
+uint32_t TranspositionTable::keyTag(uint64_t key) const
+{
+    return static_cast<uint32_t>(key / bucketCount);
+}
+
+// Each thread keeps to one shard of the counters
+TranspositionTable::StatShard& TranspositionTable::shard() const
+{
+    static std::atomic<unsigned> nextShard(0);
+    thread_local unsigned id = nextShard++ % STAT_SHARDS;
+    return stats[id];
+}
+
+// Multiply-xorshift over whole words, fast enough to check a large table at startup
+uint64_t TranspositionTable::checksum(const uint64_t* words, size_t count, uint64_t hash)
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        hash = (hash ^ words[i]) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+uint32_t TranspositionTable::packPayload(const TableEntry& entry, uint32_t age)
+{
+    uint32_t depth = entry.depth < 0 ? 0 : entry.depth > 255 ? 255 : entry.depth;
+    return static_cast<uint32_t>(entry.value) << VALUE_SHIFT |
+           static_cast<uint32_t>(entry.bound) << BOUND_SHIFT |
+           static_cast<uint32_t>((entry.move + 1) & 0xF) << MOVE_SHIFT |
+           age << AGE_SHIFT |
+           depth << DEPTH_SHIFT;
+}
+
+void TranspositionTable::unpackPayload(uint32_t payload, TableEntry& entry)
+{
+    entry.value = static_cast<uint8_t>(payload >> VALUE_SHIFT);
+    entry.bound = static_cast<Bound>((payload >> BOUND_SHIFT) & 3);
+    entry.move = static_cast<int>((payload >> MOVE_SHIFT) & 0xF) - 1;
+    entry.depth = (payload >> DEPTH_SHIFT) & 0xFF;
+}
+
+
+
+// TableSnapshotter
+//----------------------------------------------------------------------------------------//
+
+TableSnapshotter::TableSnapshotter(const TranspositionTable& table, const std::string& path, int rows, int cols,
+                                   int intervalSeconds):
+    table(table),
+    path(path),
+    rows(rows),
+    cols(cols),
+    intervalSeconds(intervalSeconds),
+    stopping(false)
+{
+    if(intervalSeconds > 0)
+        thread = std::thread(&TableSnapshotter::run, this);
+}
+
+TableSnapshotter::~TableSnapshotter()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    if(thread.joinable())
+        thread.join();
+    save();
+}
+
+bool TableSnapshotter::save()
+{
+    std::lock_guard<std::mutex> guard(saveLock);
+    return table.save(path, rows, cols);
+}
+
+void TableSnapshotter::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while(!wake.wait_for(guard, std::chrono::seconds(intervalSeconds), [this]() { return stopping; }))
+        save();
+}
@@ -0,0 +1,174 @@
+// Connect 4
+// Transposition table header file
+
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// What a stored value says about the true score
+enum class Bound : uint8_t
+{
+    None,
+    Upper,
+    Lower,
+    Exact
+};
+
+// One unpacked search result
+struct TableEntry
+{
+    uint8_t value; // Meaning is up to the search, 0 is never stored
+    Bound bound;
+    int move;      // -1 for none, otherwise 0 to 14
+    int depth;     // Work behind the value, deeper entries are kept longer (0 to 255)
+};
+
+// Lookup and replacement counts since the last clear()
+struct TableStats
+{
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t replaced; // Stores that evicted another position
+
+    double getHitRate() const;
+    double getEvictionRate() const; // Share of stores that evicted another position
+};
+
+/*
+The table is an array of 64-byte buckets, each one cache line holding
+BUCKET_SIZE entries, and a key only ever looks inside its own bucket.
+Every entry is a single 64-bit word:
+  high 32 bits  key / bucket count (the tag) XOR the payload
+  low 32 bits   payload: value, bound, move, depth and age
+An entry matches when its two halves XOR back to the tag, so an empty slot
+or a word left over from another key never passes for a hit, and one atomic
+load or store moves a whole entry: no locks, no torn reads.
+
+The bucket is key % bucket count and the tag the quotient, so together they
+give the key back exactly as long as the quotient fits in 32 bits, that is
+for keys below buckets * 2^32. The constructor takes the width of the keys
+it will be given and never makes fewer buckets than that needs: the 49-bit
+keys of a 7x6 board take 2^17 buckets, 8 MB, and a smaller -m is rounded
+up. A prime bucket count spreads keys that differ only in high bits. When a bucket is full the entry with
+the least depth is replaced, and among equal depths one stored by an earlier
+search goes first, so deep results stay warm across any number of searches.
+
+Snapshot file layout (native byte order):
+  header   "C4TT", version, rows, cols, bucket count, age, checksum (64 bytes)
+  buckets  the table memory exactly as it is laid out in RAM
+load() maps the file copy-on-write and uses it as the table in place, so a
+restarted process has its old results back after one checksum pass. Keys
+depend on the board size, so a snapshot only loads into a game of the size
+it was saved from.
+*/
+
+// Fixed-size cache of search results indexed by position key, safe to share between threads
+class TranspositionTable
+{
+    public:
+        TranspositionTable(size_t megabytes = DEFAULT_MB, int keyBits = DEFAULT_KEY_BITS); // Rounded up to fit keyBits
+        ~TranspositionTable();
+        TranspositionTable(const TranspositionTable&) = delete;
+        TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+        // Table access
+        bool probe(uint64_t key, TableEntry& entry) const;
+        void store(uint64_t key, const TableEntry& entry);
+        void newSearch(); // Ages the entries already stored
+        void clear();
+
+        // Snapshots, rows and cols are those of the game the keys came from
+        bool save(const std::string& path, int rows, int cols) const; // Safe while other threads search
+        bool load(const std::string& path, int rows, int cols);       // Replaces the table, size included
+
+        // Getters
+        size_t getSize() const; // Entries
+        size_t getBytes() const;
+        bool usesHugePages() const; // Pages actually backed as huge pages, not just requested
+        TableStats getStats() const;
+
+        static const size_t DEFAULT_MB = 64;
+        static const int DEFAULT_KEY_BITS = 49; // Position keys of a 7x6 board
+        static const int BUCKET_SIZE = 8;
+
+    private:
+        struct alignas(64) Bucket
+        {
+            std::atomic<uint64_t> entries[BUCKET_SIZE];
+        };
+
+        // Counters are spread over cache lines so threads don't fight over one
+        struct alignas(64) StatShard
+        {
+            std::atomic<uint64_t> probes, hits, stores, replaced;
+        };
+        static const int STAT_SHARDS = 16;
+
+        struct SnapshotHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t rows, cols;
+            uint64_t bucketCount;
+            uint32_t age;
+            uint32_t bucketSize;
+            uint64_t checksum;
+            uint8_t reserved[24]; // Keeps the buckets that follow cache line aligned
+        };
+
+        static const uint32_t SNAPSHOT_VERSION = 1;
+
+        void* mapping;
+        size_t bytes;           // Size of the mapping
+        Bucket* buckets;        // Inside the mapping, after the header for a loaded snapshot
+        size_t bucketCount;
+        size_t minBuckets;      // Fewest buckets that keep every key exact
+        bool hugePages;         // Mapped with MAP_HUGETLB
+        std::atomic<uint32_t> age;
+        mutable StatShard stats[STAT_SHARDS];
+
+        // Helper methods
+        Bucket& bucket(uint64_t key) const;
+        uint32_t keyTag(uint64_t key) const;
+        StatShard& shard() const;
+        static uint32_t packPayload(const TableEntry& entry, uint32_t age);
+        static void unpackPayload(uint32_t payload, TableEntry& entry);
+        static uint64_t checksum(const uint64_t* words, size_t count, uint64_t hash);
+};
+
+// Saves a table snapshot every interval from a background thread, and once more when destroyed
+class TableSnapshotter
+{
+    public:
+        TableSnapshotter(const TranspositionTable& table, const std::string& path, int rows, int cols,
+                         int intervalSeconds = 300); // 0 saves only when destroyed
+        ~TableSnapshotter();
+
+        TableSnapshotter(const TableSnapshotter&) = delete;
+        TableSnapshotter& operator=(const TableSnapshotter&) = delete;
+
+        bool save(); // Save right away, from any thread
+
+    private:
+        const TranspositionTable& table;
+        std::string path;
+        int rows, cols;
+        int intervalSeconds;
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping;
+        std::mutex saveLock; // One save at a time, they share a temporary file
+
+        void run();
+};
+
+#endif
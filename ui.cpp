@@ -2,14 +2,18 @@
 // Contains function implementations for the connect 4 graphics and ui
 
 #include "ui.h"
+#include "perf.h"
 
-Connect4UI::Connect4UI(float x, float y, float size): boardX(x), boardY(y), cellSize(size)
+template<typename Game>
+BasicConnect4UI<Game>::BasicConnect4UI(float x, float y, float size)
+    : boardX(x), boardY(y), cellSize(size), boardTexture{}, textureLoaded(false), textureValid(false),
+      drawnGame(nullptr), drawnVersion(0), drawnPieces{0, 0}, perfFrom{}, perfTo{}, perfSampleTime(0)
 {
     // Calculate derived values
-    pieceRadius = cellSize * 0.35f;  // Pieces are 70% of cell size
-    boardWidth = 7 * cellSize;       // 7 columns
-    boardHeight = 6 * cellSize;      // 6 rows
-    roundness = 0.1f;                // For rounded rectangles
+    pieceRadius = cellSize * 0.35f;      // Pieces are 70% of cell size
+    boardWidth = Game::COLS * cellSize;  // Columns of the game type
+    boardHeight = Game::ROWS * cellSize; // Rows of the game type
+    roundness = 0.1f;                    // For rounded rectangles
 
     // Set default colors using GameColor struct
     boardColor = GameColor(0, 100, 200, 255);         // Blue board
@@ -19,33 +23,34 @@ Connect4UI::Connect4UI(float x, float y, float size): boardX(x), boardY(y), cell
     backgroundColors = GameColor(200, 200, 200, 255); // Light gray background
 }
 
+template<typename Game>
+BasicConnect4UI<Game>::~BasicConnect4UI()
+{
+    unloadBoardTexture();
+}
+
 
 
 // Rendering
 //----------------------------------------------------------------------------------------//
 
 // Draw the entire Connect4 board
-void Connect4UI::drawBoard(const Connect4Game& game)
+// The board is kept in a texture and only cells that changed since the last
+// frame are redrawn into it, so an unchanged board costs a single blit
+template<typename Game>
+void BasicConnect4UI<Game>::drawBoard(const Game& game)
 {
-    // Draw the board background
-    DrawRectangleRounded({boardX, boardY, boardWidth, boardHeight}, roundness, 0, gameColorToRaylib(boardColor));
+    PERF_TIMER(DrawBoard);
+    updateBoardTexture(game);
 
-    // Draw all the slots and pieces
-    for(int row = 0; row < game.getRows(); ++row)
-    {
-        for(int col = 0; col < game.getCols(); ++col)
-        {
-            int cellValue = game.getBoardValue(row, col);
-            if(cellValue == 0)
-                drawEmptySlot(row, col);
-            else
-                drawPiece(row, col, cellValue);
-        }
-    }
+    // Render textures are stored upside down, flip the source rectangle
+    Rectangle source = {0, 0, static_cast<float>(boardTexture.texture.width), -static_cast<float>(boardTexture.texture.height)};
+    DrawTextureRec(boardTexture.texture, source, {boardX, boardY}, WHITE);
 }
 
 // Draw colored pieces for players
-void Connect4UI::drawPiece(int row, int col, int player)
+template<typename Game>
+void BasicConnect4UI<Game>::drawPiece(int row, int col, int player)
 {
     float centerX = getCellCenterX(col);
     float centerY = getCellCenterY(row);
@@ -66,7 +71,8 @@ void Connect4UI::drawPiece(int row, int col, int player)
 }
 
 // Draw a white circle for empty space
-void Connect4UI::drawEmptySlot(int row, int col)
+template<typename Game>
+void BasicConnect4UI<Game>::drawEmptySlot(int row, int col)
 {
     float centerX = getCellCenterX(col);
     float centerY = getCellCenterY(row);
@@ -75,9 +81,11 @@ void Connect4UI::drawEmptySlot(int row, int col)
 }
 
 // Draw game status messages
-void Connect4UI::drawGameStatus(const Connect4Game& game)
+template<typename Game>
+void BasicConnect4UI<Game>::drawGameStatus(const Game& game)
 {
-    const char* statusText; // raylib DrawText() function requires a const char*
+    PERF_TIMER(DrawStatus);
+    const char* statusText = ""; // raylib DrawText() function requires a const char*
     Color textColor = BLACK; // raylib color
 
     if(game.isGameOver())
@@ -109,12 +117,54 @@ void Connect4UI::drawGameStatus(const Connect4Game& game)
 }
 
 
+// Draw counter rates and average section times, refreshed twice a second
+template<typename Game>
+void BasicConnect4UI<Game>::drawPerfOverlay(float x, float y)
+{
+    const int fontSize = 16;
+    const int lineHeight = 20;
+
+    if(!Perf::isEnabled())
+    {
+        DrawText("Performance counters are off (make DEFINES=-DC4_PERF)", x, y, fontSize, DARKGRAY);
+        return;
+    }
+
+    if(GetTime() - perfSampleTime >= 0.5)
+    {
+        perfFrom = perfTo;
+        perfTo = Perf::snapshot();
+        perfSampleTime = GetTime();
+    }
+
+    double seconds = perfTo.seconds - perfFrom.seconds;
+    if(seconds <= 0)
+        seconds = 1;
+
+    DrawRectangle(x - 5, y - 5, 245, (PERF_COUNTERS + PERF_TIMERS) * lineHeight + 10, Color{0, 0, 0, 160});
+    for(int i = 0; i < PERF_COUNTERS; ++i)
+    {
+        double rate = (perfTo.counters[i] - perfFrom.counters[i]) / seconds;
+        DrawText(TextFormat("%s: %.0f/s", Perf::getName(static_cast<PerfCounter>(i)), rate), x, y, fontSize, WHITE);
+        y += lineHeight;
+    }
+    for(int i = 0; i < PERF_TIMERS; ++i)
+    {
+        uint64_t calls = perfTo.timerCalls[i] - perfFrom.timerCalls[i];
+        double ms = calls ? (perfTo.timerNanos[i] - perfFrom.timerNanos[i]) / 1e6 / calls : 0.0;
+        DrawText(TextFormat("%s: %.3f ms", Perf::getName(static_cast<PerfTimer>(i)), ms), x, y, fontSize, WHITE);
+        y += lineHeight;
+    }
+}
+
+
 
 // Input handling
 //----------------------------------------------------------------------------------------//
 
 // Determine board column number based on mouse x position
-int Connect4UI::getColumnFromMouseX(float mouseX) const
+template<typename Game>
+int BasicConnect4UI<Game>::getColumnFromMouseX(float mouseX) const
 {
     // Check if mouse is within board horizontal bounds
     if(mouseX < boardX || mouseX > boardX + boardWidth)
@@ -127,7 +177,8 @@ int Connect4UI::getColumnFromMouseX(float mouseX) const
 }
 
 // Check if mouse is over the game board
-bool Connect4UI::isMouseOverBoard(float mouseX, float mouseY) const
+template<typename Game>
+bool BasicConnect4UI<Game>::isMouseOverBoard(float mouseX, float mouseY) const
 {
     return (mouseX >= boardX && mouseX <= boardX + boardWidth && mouseY >= boardY && mouseY <= boardY + boardHeight);
 }
@@ -138,28 +189,35 @@ bool Connect4UI::isMouseOverBoard(float mouseX, float mouseY) const
 //----------------------------------------------------------------------------------------//
 
 // Move board to new position
-void Connect4UI::setBoardPosition(float x, float y)
+template<typename Game>
+void BasicConnect4UI<Game>::setBoardPosition(float x, float y)
 {
     boardX = x;
     boardY = y;
 }
 
 // Resize board cells
-void Connect4UI::setCellSize(float size)
+template<typename Game>
+void BasicConnect4UI<Game>::setCellSize(float size)
 {
     cellSize = size;
     pieceRadius = cellSize * 0.35f;  // Recalculate piece size
-    boardWidth = 7 * cellSize;       // Recalculate board dimensions
-    boardHeight = 6 * cellSize;
+    boardWidth = Game::COLS * cellSize;  // Recalculate board dimensions
+    boardHeight = Game::ROWS * cellSize;
+
+    unloadBoardTexture(); // Wrong size now, recreated on the next draw
 }
 
 // Set new game colors
-void Connect4UI::setColors(GameColor board, GameColor p1, GameColor p2, GameColor empty)
+template<typename Game>
+void BasicConnect4UI<Game>::setColors(GameColor board, GameColor p1, GameColor p2, GameColor empty)
 {
     boardColor = board;
     player1Color = p1;
     player2Color = p2;
     emptySlotColor = empty;
+
+    textureValid = false; // Every cell changes color
 }
 
 
@@ -167,27 +225,32 @@ void Connect4UI::setColors(GameColor board, GameColor p1, GameColor p2, GameColo
 // Getters
 //----------------------------------------------------------------------------------------//
 
-float Connect4UI::getBoardX() const 
+template<typename Game>
+float BasicConnect4UI<Game>::getBoardX() const 
 { 
     return boardX; 
 }
 
-float Connect4UI::getBoardY() const 
+template<typename Game>
+float BasicConnect4UI<Game>::getBoardY() const 
 { 
     return boardY; 
 }
 
-float Connect4UI::getBoardWidth() const 
+template<typename Game>
+float BasicConnect4UI<Game>::getBoardWidth() const 
 { 
     return boardWidth; 
 }
 
-float Connect4UI::getBoardHeight() const 
+template<typename Game>
+float BasicConnect4UI<Game>::getBoardHeight() const 
 { 
     return boardHeight; 
 }
 
-float Connect4UI::getCellSize() const
+template<typename Game>
+float BasicConnect4UI<Game>::getCellSize() const
 {
     return cellSize;
 }
@@ -198,18 +261,106 @@ float Connect4UI::getCellSize() const
 //----------------------------------------------------------------------------------------//
 
 // Turn gameColor to raylib Color
-Color Connect4UI::gameColorToRaylib(GameColor gc) const
+template<typename Game>
+Color BasicConnect4UI<Game>::gameColorToRaylib(GameColor gc) const
 {
     return Color{gc.r, gc.g, gc.b, gc.a}; // raylib Color is a c struct use {} to initialize
 }
 
-float Connect4UI::getCellCenterX(int col) const
+// Bring the cached board image up to date with the game
+template<typename Game>
+void BasicConnect4UI<Game>::updateBoardTexture(const Game& game)
+{
+    if(!textureLoaded)
+    {
+        boardTexture = LoadRenderTexture(static_cast<int>(boardWidth), static_cast<int>(boardHeight));
+        textureLoaded = true;
+        textureValid = false;
+    }
+
+    // Nothing moved since the last draw
+    if(textureValid && drawnGame == &game && drawnVersion == game.getVersion())
+        return;
+
+    typename Game::Bitboard pieces1 = game.getPlayerPieces(Game::PLAYER1);
+    typename Game::Bitboard pieces2 = game.getPlayerPieces(Game::PLAYER2);
+
+    // Cells drawn over a see-through color would blend with the old one, so redraw everything
+    bool opaque = player1Color.a == 255 && player2Color.a == 255 && emptySlotColor.a == 255;
+    bool redrawAll = !textureValid || !opaque;
+    typename Game::Bitboard changed = (pieces1 ^ drawnPieces[0]) | (pieces2 ^ drawnPieces[1]);
+
+    BeginTextureMode(boardTexture);
+    if(redrawAll)
+    {
+        ClearBackground(BLANK);
+        DrawRectangleRounded({0, 0, boardWidth, boardHeight}, roundness, 0, gameColorToRaylib(boardColor));
+    }
+
+    for(int row = 0; row < Game::ROWS; ++row)
+    {
+        for(int col = 0; col < Game::COLS; ++col)
+        {
+            typename Game::Bitboard cell = Game::cellBit(row, col);
+            if(!redrawAll && !(changed & cell))
+                continue;
+
+            int player = (pieces1 & cell) ? Game::PLAYER1 : (pieces2 & cell) ? Game::PLAYER2 : Game::EMPTY;
+            drawCachedCell(row, col, player);
+        }
+    }
+    EndTextureMode();
+
+    textureValid = true;
+    drawnGame = &game;
+    drawnVersion = game.getVersion();
+    drawnPieces[0] = pieces1;
+    drawnPieces[1] = pieces2;
+}
+
+// Draw one slot into the board texture (texture coordinates start at the board corner)
+template<typename Game>
+void BasicConnect4UI<Game>::drawCachedCell(int row, int col, int player)
+{
+    GameColor color = emptySlotColor;
+    if(player == Game::PLAYER1)
+        color = player1Color;
+    else if(player == Game::PLAYER2)
+        color = player2Color;
+
+    float centerX = (col * cellSize) + (cellSize / 2.0f);
+    float centerY = (row * cellSize) + (cellSize / 2.0f);
+    DrawCircle(centerX, centerY, pieceRadius, gameColorToRaylib(color));
+}
+
+template<typename Game>
+void BasicConnect4UI<Game>::unloadBoardTexture()
+{
+    // The texture went away with the window if that was closed first
+    if(textureLoaded && IsWindowReady())
+        UnloadRenderTexture(boardTexture);
+
+    textureLoaded = false;
+    textureValid = false;
+}
+
+template<typename Game>
+float BasicConnect4UI<Game>::getCellCenterX(int col) const
 {
     return boardX + (col * cellSize) + (cellSize / 2.0f);
 }
 
-float Connect4UI::getCellCenterY(int row) const
+template<typename Game>
+float BasicConnect4UI<Game>::getCellCenterY(int row) const
 {
     return boardY + (row * cellSize) + (cellSize / 2.0f);
 }
 
+
+
+// Board sizes in use
+//----------------------------------------------------------------------------------------//
+
+template class BasicConnect4UI<Connect4Game>;
+template class BasicConnect4UI<Connect4Game8x7>;
+template class BasicConnect4UI<Connect4Game9x7>;
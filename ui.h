@@ -6,18 +6,26 @@
 
 #include "raylib.h"
 #include "connect4.h"
+#include "perf.h"
 
-// Connect4 UI
-class Connect4UI 
+// Connect4 UI, sized for the rows and columns of one game type
+template<typename Game>
+class BasicConnect4UI 
 {
     public:
-        Connect4UI(float x, float y, float size);
+        BasicConnect4UI(float x, float y, float size);
+        ~BasicConnect4UI();
+
+        // Owns a GPU texture, so it can't be copied
+        BasicConnect4UI(const BasicConnect4UI&) = delete;
+        BasicConnect4UI& operator=(const BasicConnect4UI&) = delete;
 
         // Rendering
-        void drawBoard(const Connect4Game& game);
+        void drawBoard(const Game& game);
         void drawPiece(int row, int col, int player);
         void drawEmptySlot(int row, int col);
-        void drawGameStatus(const Connect4Game& game);
+        void drawGameStatus(const Game& game);
+        void drawPerfOverlay(float x, float y); // Counter rates and section times (needs C4_PERF)
 
         // Input handling
         int getColumnFromMouseX(float mouseX) const;
@@ -48,10 +56,36 @@ class Connect4UI
         GameColor emptySlotColor;
         GameColor backgroundColors;
 
+        // Board image cache, created on the first draw (needs an open window)
+        RenderTexture2D boardTexture;
+        bool textureLoaded;
+        bool textureValid;               // False when everything has to be redrawn
+        const Game* drawnGame;           // Game and version the texture shows
+        unsigned drawnVersion;
+        typename Game::Bitboard drawnPieces[2];
+
+        // Performance overlay, shows the change between two snapshots
+        PerfSnapshot perfFrom;
+        PerfSnapshot perfTo;
+        double perfSampleTime;
+
         // Helper functions
         Color gameColorToRaylib(GameColor gc) const;
+        void updateBoardTexture(const Game& game);
+        void drawCachedCell(int row, int col, int player);
+        void unloadBoardTexture();
         float getCellCenterX(int col) const;
         float getCellCenterY(int row) const;
 };
 
+// UI for each board size in use
+using Connect4UI = BasicConnect4UI<Connect4Game>;
+using Connect4UI8x7 = BasicConnect4UI<Connect4Game8x7>;
+using Connect4UI9x7 = BasicConnect4UI<Connect4Game9x7>;
+
+// Compiled once in ui.cpp
+extern template class BasicConnect4UI<Connect4Game>;
+extern template class BasicConnect4UI<Connect4Game8x7>;
+extern template class BasicConnect4UI<Connect4Game9x7>;
+
 #endif